@@ -0,0 +1,141 @@
+#ifndef _LCD_BLIT_EXPAND_H
+#define _LCD_BLIT_EXPAND_H
+
+/*
+ * 单色(1bpp)字形展开为16/32bpp像素, 驱动的fb_imageblit和用户态测试程序共用
+ * 每次处理4个bit(一个nibble): 查表直接得到4个像素, 16bpp写2个32位字, 32bpp写4个32位字;
+ * 每行从左到右顺序写出, 适合写合并的显存
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+struct lcd_expand_table {
+	uint32_t fg;
+	uint32_t bg;
+	unsigned int bpp;
+	uint32_t tab[16][4];	/* nibble -> 4个像素; 16bpp只用前2个字 */
+};
+
+/* 按前景/背景色生成查找表, 颜色已经是目标格式的像素值 */
+static inline void lcd_expand_table_init(struct lcd_expand_table *t, uint32_t fg,
+					 uint32_t bg, unsigned int bpp)
+{
+	unsigned int n, i;
+
+	t->fg = fg;
+	t->bg = bg;
+	t->bpp = bpp;
+	for (n = 0; n < 16; n++) {
+		if (bpp == 16) {
+			/* 小端: 左边的像素(高位bit)在低16位 */
+			for (i = 0; i < 2; i++) {
+				uint32_t lo = (n & (8 >> (2 * i))) ? fg : bg;
+				uint32_t hi = (n & (4 >> (2 * i))) ? fg : bg;
+
+				t->tab[n][i] = (lo & 0xffff) | (hi << 16);
+			}
+		} else {
+			for (i = 0; i < 4; i++)
+				t->tab[n][i] = (n & (8 >> i)) ? fg : bg;
+		}
+	}
+}
+
+/* 颜色不变时不重建表 */
+static inline void lcd_expand_table_update(struct lcd_expand_table *t, uint32_t fg,
+					   uint32_t bg, unsigned int bpp)
+{
+	if (t->fg != fg || t->bg != bg || t->bpp != bpp)
+		lcd_expand_table_init(t, fg, bg, bpp);
+}
+
+/* 从第x个bit开始取8个bit, x不是8的倍数时跨两个字节 */
+static inline unsigned int lcd_expand_bits8(const uint8_t *s, unsigned int x)
+{
+	unsigned int sh = x & 7;
+
+	s += x >> 3;
+	if (!sh)
+		return s[0];
+	return ((s[0] << sh) | (s[1] >> (8 - sh))) & 0xff;
+}
+
+/*
+ * 把width x height的单色位图展开到dst
+ * src每行spitch字节, 最高位是最左边的像素; dst每行dstride字节
+ * 16bpp时dst只有2字节对齐(dx为奇数)时先单独写一个像素, 之后按32位字写
+ */
+static inline void lcd_expand_mono(const struct lcd_expand_table *t, void *dst,
+				   unsigned int dstride, const uint8_t *src,
+				   unsigned int spitch, unsigned int width,
+				   unsigned int height)
+{
+	unsigned int y, x, b, v;
+
+	for (y = 0; y < height; y++) {
+		const uint8_t *s = src + y * spitch;
+		uint8_t *row = (uint8_t *)dst + y * dstride;
+
+		x = 0;
+		if (t->bpp == 16) {
+			uint32_t *d;
+
+			if (((uintptr_t)row & 3) == 2 && width) {
+				*(uint16_t *)row = (s[0] & 0x80) ? t->fg : t->bg;
+				row += 2;
+				x = 1;
+			}
+			if (!((uintptr_t)row & 3)) {
+				d = (uint32_t *)row;
+				for (; x + 8 <= width; x += 8) {
+					v = lcd_expand_bits8(s, x);
+					d[0] = t->tab[v >> 4][0];
+					d[1] = t->tab[v >> 4][1];
+					d[2] = t->tab[v & 0xf][0];
+					d[3] = t->tab[v & 0xf][1];
+					d += 4;
+				}
+				row = (uint8_t *)d;
+			}
+		} else if (t->bpp == 32) {
+			uint32_t *d = (uint32_t *)row;
+
+			for (; x + 8 <= width; x += 8, s++) {
+				const uint32_t *hi = t->tab[*s >> 4];
+				const uint32_t *lo = t->tab[*s & 0xf];
+
+				d[0] = hi[0];
+				d[1] = hi[1];
+				d[2] = hi[2];
+				d[3] = hi[3];
+				d[4] = lo[0];
+				d[5] = lo[1];
+				d[6] = lo[2];
+				d[7] = lo[3];
+				d += 8;
+			}
+			row = (uint8_t *)d;
+		}
+
+		/* 剩下不足8个像素的部分逐像素写 */
+		for (; x < width; x++) {
+			uint32_t c;
+
+			b = src[y * spitch + (x >> 3)] & (0x80 >> (x & 7));
+			c = b ? t->fg : t->bg;
+			if (t->bpp == 16) {
+				*(uint16_t *)row = c;
+				row += 2;
+			} else {
+				*(uint32_t *)row = c;
+				row += 4;
+			}
+		}
+	}
+}
+
+#endif /* _LCD_BLIT_EXPAND_H */
@@ -1,80 +1,94 @@
-#include <sys/mman.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include <linux/fb.h>
-#include <fcntl.h>
+
 #include <stdio.h>
 #include <string.h>
-#include <sys/ioctl.h>
+#include <unistd.h>
+#include <stdlib.h>
 #include <time.h>
+#include <poll.h>
 
-
-static int fd_fb;
-static struct fb_var_screeninfo fb_var;	/* Current var */
-static struct fb_fix_screeninfo fb_fix;
-
-static int screen_size;
-static unsigned int line_width;
-static unsigned int pixel_width;
+#include "lcd_fb.h"
 
 /**********************************************************************
  * 函数名称： lcd_put_pixel
  * 功能描述： 在LCD指定位置上输出指定颜色（描点）
- * 输入参数： x坐标，y坐标，颜色
+ * 输入参数： surface，x坐标，y坐标，颜色
  * 输出参数： 无
  * 返 回 值： 无
- * 注     意:  	./lcd_double_buffer single
- * 				./lcd_double_buffer double
+ * 注     意:  	./lcd_double_buffer single [/dev/fbN] [rotate]
+ * 				./lcd_double_buffer double [/dev/fbN] [rotate]
+ * 				./lcd_double_buffer async [/dev/fbN] [rotate]
+ * 				async: 单线程事件循环, poll同时等待显示fence和标准输入(输入q退出)
+ * 				rotate: 0-不旋转 1-90度 2-180度 3-270度, 由驱动在切换buffer时旋转,
+ * 				每帧旋转耗时见 /sys/devices/platform/framebuffer-mylcd/rotate_stats
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -o lcd_double_buffer lcd_double_buffer.c lcd_fb.c
  ***********************************************************************/ 
-void lcd_put_pixel(void *fb_base, int x, int y, unsigned int color)
+void lcd_put_pixel(struct lcd_surface *s, int x, int y, unsigned int color)
 {
-	unsigned char *pen_8 = fb_base+y*line_width+x*pixel_width;
-	unsigned short *pen_16;	
-	unsigned int *pen_32;	
-
-	unsigned int red, green, blue;	
+	lcd_surface_put_pixel(s, x, y, color);
+}
 
-	pen_16 = (unsigned short *)pen_8;
-	pen_32 = (unsigned int *)pen_8;
+void lcd_fill(struct lcd_surface *s, unsigned int color)
+{
+	/* 按行填充，一次写一整行 */
+	lcd_surface_fill(s, color);
+}
 
-	switch (fb_var.bits_per_pixel)
-	{
-		case 8:
-		{
-			*pen_8 = color;
-			break;
-		}
-		case 16:
-		{
-			/* 565 */
-			red   = (color >> 16) & 0xff;
-			green = (color >> 8) & 0xff;
-			blue  = (color >> 0) & 0xff;
-			color = ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3);
-			*pen_16 = color;
-			break;
+/**********************************************************************
+ * 函数名称： lcd_async_loop
+ * 功能描述： 异步显示的事件循环: 有空闲buffer就绘制并提交，
+ * 			  然后poll等待显示fence或输入，渲染和扫描互相重叠
+ * 输入参数： display，颜色表，颜色个数
+ * 输出参数： 无
+ * 返 回 值： 0-正常退出，-1-出错
+ ***********************************************************************/
+static int lcd_async_loop(struct lcd_display *disp, unsigned int *colors, int ncolors)
+{
+	struct pollfd fds[2];
+	struct timespec t0, t1;
+	unsigned int frames = 0;
+	int i = 0, index;
+	char c;
+
+	fds[0].fd = lcd_display_event_fd(disp);
+	fds[0].events = POLLIN;
+	fds[1].fd = 0;
+	fds[1].events = POLLIN;
+	if (fds[0].fd < 0)
+		return -1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	while (1) {
+		/* 绘制并提交所有空闲buffer */
+		while ((index = lcd_display_acquire(disp)) >= 0) {
+			lcd_fill(lcd_display_buffer(disp, index), colors[i]);
+			i = (i + 1) % ncolors;
+			if (lcd_display_present(disp, index))
+				break;
+			/* 模拟时提交即完成, 每次只提交一帧以免空转 */
+			if (disp->present_emulated)
+				break;
 		}
-		case 32:
-		{
-			*pen_32 = color;
-			break;
+
+		if (poll(fds, 2, 1000) < 0)
+			return -1;
+		if (fds[0].revents & POLLIN) {
+			lcd_display_dispatch(disp);
+			frames++;
 		}
-		default:
-		{
-			printf("can't surport %dbpp\n", fb_var.bits_per_pixel);
-			break;
+		if (fds[1].revents & POLLIN) {
+			if (read(0, &c, 1) <= 0 || c == 'q')
+				return 0;
 		}
-	}
-}
 
-void lcd_fill(void *fb_base, unsigned int color)
-{
-	int x,y;
-	for(x = 0; x < fb_var.xres; x++)
-		for(y = 0; y < fb_var.yres; y++){
-			lcd_put_pixel(fb_base, x, y, color);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		if (t1.tv_sec - t0.tv_sec >= 1) {
+			printf("events/s = %u, displayed = %llu, released = %llu\n", frames,
+			       (unsigned long long)disp->status.displayed,
+			       (unsigned long long)disp->status.released);
+			frames = 0;
+			t0 = t1;
 		}
+	}
 }
 
 
@@ -82,121 +96,62 @@ void lcd_fill(void *fb_base, unsigned int color)
 int main(int argc, char **argv)
 {
 	int i;
-	int nBuffers;
-	void *fb_base, *pNextBuffer_addr;
-	int nNextBuffer = 0;//使用第几个buffer
+	struct lcd_display *disp;
+	struct lcd_surface *pNextBuffer;
+	unsigned int nNextBuffer;//使用第几个buffer
+	const char *dev = "/dev/fb0";
 	unsigned int colors[] = {0x00FF0000, 0x0000FF00, 0x000000FF, 0, 0x00FFFFFF};  /* 0x00RRGGBB */
 	struct timespec time;
 	time.tv_sec = 0;
 	time.tv_nsec = 100000000;
-	if(argc != 2){
-		printf("usage : %s <single|double>\n ", argv[0]);
+	if(argc < 2 || argc > 4){
+		printf("usage : %s <single|double|async> [/dev/fbN] [rotate]\n ", argv[0]);
 		return -1;
 	}
+	if (argc >= 3)
+		dev = argv[2];
 	
-	/* 打开 framebuffer 设备 */
-	fd_fb = open("/dev/fb0", O_RDWR);
-	if (fd_fb < 0)
-	{
-		printf("can't open /dev/fb0\n");
-		return -1;
-	}
-	/* 获取屏幕参数 */
-	if (ioctl(fd_fb, FBIOGET_FSCREENINFO, &fb_fix))
-	{
-		printf("can't get var\n");
+	/* 打开 framebuffer 设备，映射显存并设置多buffer */
+	disp = lcd_display_open(dev, 0);
+	if (!disp)
 		return -1;
-	}
-	if (ioctl(fd_fb, FBIOGET_VSCREENINFO, &fb_var))
-	{
-		printf("can't get var\n");
+	/* 竖屏安装时设置旋转 */
+	if (argc == 4 && lcd_display_set_rotate(disp, strtoul(argv[3], NULL, 0)))
 		return -1;
-	}
 
-	line_width  = fb_fix.line_length;//每行字节数
-	pixel_width = fb_var.bits_per_pixel / 8;//每个像素多少字节
-	screen_size = fb_fix.line_length * fb_var.yres;//屏幕总需内存大小
-	/* 申请多buffer的内存空间 */
-	fb_base = (unsigned char *)mmap(NULL , fb_fix.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_fb, 0);
-	if (fb_base == (unsigned char *)-1)
-	{
-		printf("can't mmap\n");
-		return -1;
-	}
-
-	// 计算是否支持多buffer，有多少个buffer
-	nBuffers = fb_fix.smem_len / screen_size;
-	printf("fb_fix.smem_len = %d\n", fb_fix.smem_len);
-	printf("screen_size = %d\n", screen_size);
-	printf("nBuffers = %d\n", nBuffers);
-	/* 虚拟y分辨率为多个buffer的空间 */
-	fb_var.yres_virtual = nBuffers * fb_var.yres;
-	ioctl(fd_fb, FBIOPUT_VSCREENINFO, &fb_var);
-	printf("yres_virtual = %d\n", fb_var.yres_virtual);
+	printf("fb_fix.smem_len = %d\n", disp->fix.smem_len);
+	printf("screen_size = %d\n", disp->fix.line_length * disp->var.yres);
+	printf("nBuffers = %d\n", disp->nbuffers);
+	printf("yres_virtual = %d\n", disp->var.yres_virtual);
 	/* 使用单buffer */
-	if((strcmp(argv[1], "single") == 0) || (nBuffers == 1)){
+	if((strcmp(argv[1], "single") == 0) || (disp->nbuffers == 1)){
 		while(1){
 			for(i = 0; i < sizeof(colors)/sizeof(colors[0]); i++){
-				lcd_fill(fb_base, colors[i]);
-				sleep(1);//休眠100MS
+				lcd_fill(lcd_display_buffer(disp, disp->front), colors[i]);
+				sleep(1);//休眠1S
 			}
 		}
 	}
+	else if(strcmp(argv[1], "async") == 0){
+		lcd_async_loop(disp, colors, sizeof(colors)/sizeof(colors[0]));
+	}
 	else if(strcmp(argv[1], "double") == 0){
 		while(1){
 			for(i = 0; i < sizeof(colors)/sizeof(colors[0]); i++){
-				/* 记录下个buffer的地址 */
-				pNextBuffer_addr = fb_base + nNextBuffer * screen_size;
-				lcd_fill(pNextBuffer_addr, colors[i]);
+				/* 在后台buffer中绘制 */
+				nNextBuffer = lcd_display_back_index(disp);
+				pNextBuffer = lcd_display_buffer(disp, nNextBuffer);
+				lcd_fill(pNextBuffer, colors[i]);
 				printf("nNextBuffer = %d\n", nNextBuffer);
-				nNextBuffer = !nNextBuffer;
-				/* 设置buffer偏移大小 */
-				fb_var.yoffset = nNextBuffer * fb_var.yres;
-				/* 把偏移后的buffer地址写入寄存器,就可以使用新的buffer */
-				ioctl(fd_fb, FBIOPAN_DISPLAY, &fb_var);
+				/* 把后台buffer切换为显示buffer */
+				lcd_display_flip(disp, nNextBuffer);
 				nanosleep(&time,NULL);//休眠100MS
 			}
 		}
 	}
 
 	/* 退出 */
-	munmap(fb_base , screen_size);
-	close(fd_fb);
+	lcd_display_close(disp);
 	
 	return 0;	
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
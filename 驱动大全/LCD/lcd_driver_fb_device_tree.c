@@ -21,18 +21,26 @@
 #include <video/videomode.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
+#include <linux/dmaengine.h>
+#include <linux/scatterlist.h>
+#include <linux/eventfd.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/of_reserved_mem.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#if IS_ENABLED(CONFIG_MXC_PXP_V2) || IS_ENABLED(CONFIG_MXC_PXP_V3)
+#include <linux/pxp_dma.h>
+#endif
 
 #include "mxc/mxc_dispdrv.h"
-
-
-struct fb_info *fb_info;
-
-static unsigned int pseudo_palette[16];
-
-static struct gpio_desc *bl_gpio = NULL;
-
-static struct clk* clk_pix;
-static struct clk* clk_axi;
+#include "lcd_ioctl.h"
+#include "lcd_present.h"
+#include "lcd_blit_expand.h"
 
 /* lcdif寄存器 */
 struct imx6ull_lcdif {
@@ -113,9 +121,208 @@ struct imx6ull_lcdif {
   volatile unsigned int AS_CLRKEYHIGH;                   
        unsigned char RESERVED_29[12];
   volatile unsigned int SYNC_DELAY;                      
+       unsigned char RESERVED_30[2204];
+  volatile unsigned int LUT_CTRL;                        
+       unsigned char RESERVED_31[12];
+  volatile unsigned int LUT0_ADDR;                       
+       unsigned char RESERVED_32[12];
+  volatile unsigned int LUT0_DATA;                       
+       unsigned char RESERVED_33[12];
+  volatile unsigned int LUT1_ADDR;                       
+       unsigned char RESERVED_34[12];
+  volatile unsigned int LUT1_DATA;                       
 } ;
 
-static struct imx6ull_lcdif *lcdif;
+
+/* CTRL 像素格式相关位 */
+#define CTRL_RUN			(1 << 0)
+#define CTRL_WORD_LENGTH_SHIFT		8
+#define CTRL_WORD_LENGTH_MASK		(0x3 << CTRL_WORD_LENGTH_SHIFT)
+
+/* LUT_CTRL: [0] 1-旁路LUT, 0-8位像素经过LUT0展开为24位RGB */
+#define LUT_CTRL_LUT_BYPASS		(1 << 0)
+
+/* CTRL1 中断相关位 */
+#define CTRL1_RECOVER_ON_UNDERFLOW	(1 << 24)
+#define CTRL1_FIFO_CLEAR		(1 << 21)
+#define CTRL1_OVERFLOW_IRQ_EN		(1 << 15)
+#define CTRL1_UNDERFLOW_IRQ_EN		(1 << 14)
+#define CTRL1_CUR_FRAME_DONE_IRQ_EN	(1 << 13)
+#define CTRL1_OVERFLOW_IRQ		(1 << 11)
+#define CTRL1_UNDERFLOW_IRQ		(1 << 10)
+#define CTRL1_CUR_FRAME_DONE_IRQ	(1 << 9)
+#define CTRL1_IRQ_STATUS_MASK		(CTRL1_OVERFLOW_IRQ | CTRL1_UNDERFLOW_IRQ | CTRL1_CUR_FRAME_DONE_IRQ)
+
+/* CTRL2 AXI总线主机相关位 */
+#define CTRL2_OUTSTANDING_REQS_SHIFT	21
+#define CTRL2_OUTSTANDING_REQS_MASK	(0x7 << CTRL2_OUTSTANDING_REQS_SHIFT)
+#define CTRL2_BURST_LEN_8		(1 << 20)
+
+/* THRES 寄存器: [24:16] FASTCLOCK阈值, [8:0] PANIC阈值 (单位: FIFO中的像素数) */
+#define THRES_FASTCLOCK_SHIFT		16
+#define THRES_FASTCLOCK_MASK		(0x1ff << THRES_FASTCLOCK_SHIFT)
+#define THRES_PANIC_MASK		0x1ff
+#define THRES_FASTCLOCK_MAX		(THRES_FASTCLOCK_MASK >> THRES_FASTCLOCK_SHIFT)
+
+/*
+ * 显示FIFO与AXI突发参数
+ * 设备树中没有给出的项保持控制器复位值, 运行时可通过sysfs修改,
+ * 配合underflow计数在显示稳定性和DDR带宽之间折中
+ */
+struct lcdif_bus_cfg {
+	unsigned int panic_thres;	/* 低于该水位时向DDR控制器发出panic请求 */
+	unsigned int fastclock_thres;	/* 低于该水位时提升总线时钟 */
+	unsigned int burst_len;		/* AXI突发长度: 8 或 16 */
+	unsigned int outstanding_reqs;	/* AXI未完成请求数: 1/2/4/8/16 */
+	unsigned int recover_on_underflow;/* underflow后在下一帧自动恢复 */
+};
+
+/*
+ * 旋转支持
+ * 应用程序看到的是旋转后的画面(var.rotate), 显存中保存的也是旋转后的画面;
+ * 由PXP(或CPU)把选中的画面旋转到一个空闲的扫描buffer, 再把它的地址写入NEXT_BUF
+ * 扫描buffer有三个: 正在扫描的(CUR_BUF)、等待生效的(NEXT_BUF)和正在写入的,
+ * 只往前两者之外的buffer写, 一个场同步内多次pan也不会改写正在扫描的画面
+ * pan_display可能在不能睡眠的上下文中调用(fbcon), 旋转放到工作队列中做,
+ * 连续多次pan只旋转最后一次的画面
+ */
+#define LCD_ROT_BUFFERS	3
+#define LCD_ROT_STRIP	32	/* CPU旋转时一次处理的目的行数 */
+
+struct lcd_rotate_stat {
+	unsigned int count;
+	u64 last_ns;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+struct lcd_rotate_state {
+	void *buf[LCD_ROT_BUFFERS];	/* 扫描buffer(面板方向) */
+	dma_addr_t phys[LCD_ROT_BUFFERS];
+	size_t size;
+	void *scratch;			/* CPU旋转时缓存源数据的条带, 可缓存的普通内存 */
+	size_t scratch_size;
+	struct mutex lock;		/* 串行化旋转: 工作队列和MYLCDIO_PRESENT */
+	struct delayed_work work;	/* 旋转pan的画面, 以及定时刷新 */
+	unsigned int yoffset;		/* 要旋转的画面, present.lock保护 */
+	bool pan_pending;		/* 有尚未旋转的pan, present.lock保护 */
+	struct dma_chan *pxp_chan;	/* 没有PXP时为NULL */
+	bool use_pxp;
+	struct completion pxp_done;
+	struct lcd_rotate_stat stat[4];	/* 按FB_ROTATE_xx统计每帧旋转耗时 */
+};
+
+/*
+ * probe的各个阶段, 用于测量上电到第一帧的时间
+ * SCANOUT之后控制器已经在扫描显存(清零的黑屏), FIRST_VSYNC是第一个帧结束中断
+ */
+enum lcd_probe_stage {
+	LCD_STAGE_START,
+	LCD_STAGE_TIMINGS,
+	LCD_STAGE_CLOCKS,
+	LCD_STAGE_VRAM,
+	LCD_STAGE_SCANOUT,
+	LCD_STAGE_FIRST_VSYNC,
+	LCD_STAGE_REGISTERED,
+	LCD_STAGE_NUM,
+};
+
+static const char * const lcd_stage_names[LCD_STAGE_NUM] = {
+	"start", "timings", "clocks", "vram", "scanout", "first_vsync", "registered",
+};
+
+/*
+ * 每个LCD控制器实例的私有数据, 由framebuffer_alloc()跟fb_info一起分配(fb_info->par)
+ * 每个实例有自己的寄存器、时钟、显存、显示队列和场同步, 可以同时驱动多块屏
+ */
+struct mylcd_par {
+	struct fb_info *info;
+	struct device *dev;
+	struct imx6ull_lcdif *lcdif;	/* 寄存器; 内存实例指向一块普通内存 */
+	bool mem_backed;		/* 没有LCD控制器, 只用于测试 */
+	struct gpio_desc *bl_gpio;
+	struct clk *clk_pix;
+	struct clk *clk_axi;
+	u32 pseudo_palette[16];
+
+	/* 面板 */
+	struct display_timing timing;
+	unsigned int panel_xres;	/* 面板的实际分辨率 */
+	unsigned int panel_yres;
+	unsigned int frame_hz;		/* 刷新率, 用于估算扫描带宽 */
+	unsigned int nbuffers;		/* 显存中的画面个数, probe时从模块参数取得 */
+
+	/* 8bpp调色板: 控制器LUT的软件副本, 从16bpp切回8bpp时整体写入 */
+	u32 lut_shadow[256];
+	unsigned int fb_bpp;		/* 控制器当前的fb像素位数 */
+
+	struct lcdif_bus_cfg bus_cfg;
+	struct mutex hw_lock;		/* 串行化控制器配置寄存器的读改写: sysfs写入和set_par */
+
+	/* 中断统计 */
+	atomic_t underflow_cnt;
+	atomic_t overflow_cnt;
+	atomic_t frame_cnt;
+
+	struct lcd_present_queue present;
+	/* 没有中断时用hrtimer按刷新率模拟场同步 */
+	bool has_irq;
+	int irq;
+	struct hrtimer vsync_timer;
+	ktime_t frame_period;
+
+	struct lcd_rotate_state rot;
+
+	bool has_rmem;			/* 显存来自设备树memory-region */
+	bool has_sysfs;			/* sysfs属性创建成功 */
+	ktime_t probe_ts[LCD_STAGE_NUM];	/* probe各阶段完成的时间 */
+
+	/* 上一次使用的前景/背景色对应的展开表, fbcon连续输出时颜色基本不变 */
+	struct lcd_expand_table blit_tab;
+};
+
+/*
+ * 显存中的画面个数: 用于双buffer/多buffer切换,
+ * 同时也是fbcon硬件滚屏(YPAN)的虚拟高度, 越高则滚到底部后回到顶部整屏重画的次数越少
+ */
+static unsigned int nbuffers = 3;
+module_param(nbuffers, uint, 0444);
+MODULE_PARM_DESC(nbuffers, "number of screens in VRAM for flipping and panning (default 3)");
+
+/*
+ * 测试用的内存实例个数: 不需要LCD控制器, 显存是普通的DMA内存, 场同步由hrtimer模拟,
+ * 可以和设备树中的实例同时存在, 例如 insmod lcd_driver_fb_device_tree.ko mem_instances=2
+ */
+#define LCD_MAX_MEM_INSTANCES	4
+
+static unsigned int mem_instances;
+module_param(mem_instances, uint, 0444);
+MODULE_PARM_DESC(mem_instances, "number of memory-backed test instances (default 0, max 4)");
+
+static struct platform_device *mem_pdev[LCD_MAX_MEM_INSTANCES];
+
+/*
+ * 旋转时应用(fbcon、不调用pan的mmap程序)可能直接改写正在显示的画面,
+ * 每隔一段时间重新旋转一次当前画面; 0表示只在pan/present时旋转
+ */
+static unsigned int rotate_refresh_ms = 100;
+module_param(rotate_refresh_ms, uint, 0644);
+MODULE_PARM_DESC(rotate_refresh_ms, "re-rotate the displayed frame every N ms when rotated (default 100, 0 = off)");
+
+/* 内存实例没有设备树节点, 使用与7寸屏相同的时序 */
+static const struct display_timing lcd_default_timing = {
+	.pixelclock	= { 50000000, 50000000, 50000000 },
+	.hactive	= { 1024, 1024, 1024 },
+	.hfront_porch	= { 160, 160, 160 },
+	.hback_porch	= { 140, 140, 140 },
+	.hsync_len	= { 20, 20, 20 },
+	.vactive	= { 600, 600, 600 },
+	.vfront_porch	= { 12, 12, 12 },
+	.vback_porch	= { 20, 20, 20 },
+	.vsync_len	= { 3, 3, 3 },
+	.flags		= DISPLAY_FLAGS_HSYNC_LOW | DISPLAY_FLAGS_VSYNC_LOW |
+			  DISPLAY_FLAGS_DE_HIGH | DISPLAY_FLAGS_PIXDATA_NEGEDGE,
+};
 
 
 /* 使能lcdif控制器 */
@@ -261,6 +468,853 @@ static int lcd_controller_init(struct imx6ull_lcdif *lcdif, struct display_timin
 	return 0;
 }
 
+/*
+ * 切换fb的像素格式(8bpp调色板 / 16bpp RGB565)
+ * 8bpp时每个像素是LUT0的索引, 扫描带宽和显存都只有RGB565的一半
+ */
+static void lcd_controller_set_fb_format(struct mylcd_par *par, unsigned int fb_bpp)
+{
+	struct imx6ull_lcdif *lcdif = par->lcdif;
+	unsigned int running = lcdif->CTRL & CTRL_RUN;
+	int i;
+
+	lcdif->CTRL_CLR = CTRL_RUN;
+	lcdif->CTRL_CLR = CTRL_WORD_LENGTH_MASK;
+	lcdif->CTRL_SET = (fb_bpp == 8 ? 0x1 : 0x0) << CTRL_WORD_LENGTH_SHIFT;
+	lcdif->CTRL1_SET = 0xf << 16;
+
+	if (fb_bpp == 8) {
+		lcdif->LUT0_ADDR = 0;
+		for (i = 0; i < 256; i++)
+			lcdif->LUT0_DATA = par->lut_shadow[i];	/* 地址自动加1 */
+		lcdif->LUT_CTRL = 0;
+	} else {
+		lcdif->LUT_CTRL = LUT_CTRL_LUT_BYPASS;
+	}
+	par->fb_bpp = fb_bpp;
+
+	if (running)
+		lcdif->CTRL_SET = CTRL_RUN;
+}
+
+/* outstanding请求数 1/2/4/8/16 转换为 CTRL2[23:21] 的编码 0~4 */
+static int lcd_outstanding_to_field(unsigned int reqs)
+{
+	int field;
+
+	if (!reqs || reqs > 16 || (reqs & (reqs - 1)))
+		return -EINVAL;
+	field = ffs(reqs) - 1;
+	return field;
+}
+
+/* 从控制器读出当前(复位)值, 作为设备树未配置时的默认参数 */
+static void lcd_bus_cfg_read_hw(struct imx6ull_lcdif *lcdif, struct lcdif_bus_cfg *cfg)
+{
+	unsigned int ctrl2 = lcdif->CTRL2;
+	unsigned int thres = lcdif->THRES;
+
+	cfg->panic_thres = thres & THRES_PANIC_MASK;
+	cfg->fastclock_thres = (thres & THRES_FASTCLOCK_MASK) >> THRES_FASTCLOCK_SHIFT;
+	cfg->burst_len = (ctrl2 & CTRL2_BURST_LEN_8) ? 8 : 16;
+	cfg->outstanding_reqs = 1 << ((ctrl2 & CTRL2_OUTSTANDING_REQS_MASK) >> CTRL2_OUTSTANDING_REQS_SHIFT);
+	cfg->recover_on_underflow = !!(lcdif->CTRL1 & CTRL1_RECOVER_ON_UNDERFLOW);
+}
+
+/* 解析设备树中的FIFO/突发配置, 非法值忽略并保留默认值 */
+static void lcd_bus_cfg_parse_dt(struct device *dev, struct lcdif_bus_cfg *cfg)
+{
+	struct device_node *np = dev->of_node;
+	u32 val;
+
+	if (!np)
+		return;
+	if (!of_property_read_u32(np, "panic-threshold", &val)) {
+		if (val <= THRES_PANIC_MASK)
+			cfg->panic_thres = val;
+		else
+			dev_warn(dev, "invalid panic-threshold %u\n", val);
+	}
+	if (!of_property_read_u32(np, "fastclock-threshold", &val)) {
+		if (val <= THRES_FASTCLOCK_MAX)
+			cfg->fastclock_thres = val;
+		else
+			dev_warn(dev, "invalid fastclock-threshold %u\n", val);
+	}
+	if (!of_property_read_u32(np, "burst-length", &val)) {
+		if (val == 8 || val == 16)
+			cfg->burst_len = val;
+		else
+			dev_warn(dev, "invalid burst-length %u\n", val);
+	}
+	if (!of_property_read_u32(np, "outstanding-requests", &val)) {
+		if (lcd_outstanding_to_field(val) >= 0)
+			cfg->outstanding_reqs = val;
+		else
+			dev_warn(dev, "invalid outstanding-requests %u\n", val);
+	}
+	if (of_property_read_bool(np, "recover-on-underflow"))
+		cfg->recover_on_underflow = 1;
+}
+
+/*
+ * 把FIFO阈值和AXI突发参数写入控制器
+ * THRES 直接写入; CTRL2/CTRL1 通过 SET/CLR 寄存器只修改相关位
+ */
+static void lcd_controller_bus_setup(struct imx6ull_lcdif *lcdif, struct lcdif_bus_cfg *cfg)
+{
+	lcdif->THRES = (cfg->fastclock_thres << THRES_FASTCLOCK_SHIFT) | cfg->panic_thres;
+
+	lcdif->CTRL2_CLR = CTRL2_OUTSTANDING_REQS_MASK | CTRL2_BURST_LEN_8;
+	lcdif->CTRL2_SET = (lcd_outstanding_to_field(cfg->outstanding_reqs) << CTRL2_OUTSTANDING_REQS_SHIFT) |
+	                   (cfg->burst_len == 8 ? CTRL2_BURST_LEN_8 : 0);
+
+	if (cfg->recover_on_underflow)
+		lcdif->CTRL1_SET = CTRL1_RECOVER_ON_UNDERFLOW;
+	else
+		lcdif->CTRL1_CLR = CTRL1_RECOVER_ON_UNDERFLOW;
+}
+
+/* 显示队列的program: 把一帧的地址写入NEXT_BUF, 调用者持有present.lock */
+static void lcd_next_buf_program(struct lcd_present_queue *present, dma_addr_t addr)
+{
+	struct mylcd_par *par = container_of(present, struct mylcd_par, present);
+
+	par->lcdif->NEXT_BUF = addr;
+}
+
+/* 帧结束: 处理显示队列, 记录第一次场同步的时间 */
+static void lcd_frame_done(struct mylcd_par *par)
+{
+	if (lcd_present_vsync(&par->present, par->lcdif->CUR_BUF) == 1)
+		par->probe_ts[LCD_STAGE_FIRST_VSYNC] = ktime_get();
+}
+
+/* lcdif中断: 统计underflow/overflow以及帧数, 帧结束时处理显示队列 */
+static irqreturn_t lcd_irq_handler(int irq, void *dev_id)
+{
+	struct mylcd_par *par = dev_id;
+	struct imx6ull_lcdif *lcdif = par->lcdif;
+	unsigned int status = lcdif->CTRL1 & CTRL1_IRQ_STATUS_MASK;
+
+	if (!status)
+		return IRQ_NONE;
+
+	if (status & CTRL1_UNDERFLOW_IRQ)
+		atomic_inc(&par->underflow_cnt);
+	if (status & CTRL1_OVERFLOW_IRQ)
+		atomic_inc(&par->overflow_cnt);
+	if (status & CTRL1_CUR_FRAME_DONE_IRQ) {
+		atomic_inc(&par->frame_cnt);
+		lcd_frame_done(par);
+	}
+
+	/* 写1清除中断标志 */
+	lcdif->CTRL1_CLR = status;
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * 没有中断时按刷新率模拟帧结束中断
+ * 内存实例没有控制器, 在这里把NEXT_BUF"装入"CUR_BUF
+ */
+static enum hrtimer_restart lcd_vsync_timer_fn(struct hrtimer *timer)
+{
+	struct mylcd_par *par = container_of(timer, struct mylcd_par, vsync_timer);
+
+	if (par->mem_backed)
+		par->lcdif->CUR_BUF = par->lcdif->NEXT_BUF;
+	atomic_inc(&par->frame_cnt);
+	lcd_frame_done(par);
+
+	hrtimer_forward_now(timer, par->frame_period);
+	return HRTIMER_RESTART;
+}
+
+/* 记录probe阶段完成的时间 */
+static void lcd_probe_stamp(struct mylcd_par *par, enum lcd_probe_stage stage)
+{
+	par->probe_ts[stage] = ktime_get();
+}
+
+/* 某阶段相对probe开始的时间(us), 未完成时为-1 */
+static s64 lcd_probe_delta_us(struct mylcd_par *par, enum lcd_probe_stage stage)
+{
+	if (!ktime_to_ns(par->probe_ts[stage]))
+		return -1;
+	return ktime_to_us(ktime_sub(par->probe_ts[stage], par->probe_ts[LCD_STAGE_START]));
+}
+
+/* sysfs属性所在的设备是platform设备, drvdata是fb_info */
+static struct mylcd_par *lcd_dev_to_par(struct device *dev)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+
+	return info->par;
+}
+
+/*
+ * sysfs接口: /sys/devices/platform/framebuffer-mylcd/ (内存实例在 myLcd.N/ 下)
+ * 阈值/突发参数可读写, 写入后立即生效;
+ * underflow_count/overflow_count/frame_count 是中断统计, 写0只清零该项
+ */
+#define LCD_BUS_CFG_ATTR(_name, _field, _check)					\
+static ssize_t _name##_show(struct device *dev,					\
+			    struct device_attribute *attr, char *buf)		\
+{										\
+	return sprintf(buf, "%u\n", lcd_dev_to_par(dev)->bus_cfg._field);	\
+}										\
+static ssize_t _name##_store(struct device *dev,				\
+			     struct device_attribute *attr,			\
+			     const char *buf, size_t count)			\
+{										\
+	struct mylcd_par *par = lcd_dev_to_par(dev);				\
+	unsigned int val;							\
+	int ret = kstrtouint(buf, 0, &val);					\
+										\
+	if (ret)								\
+		return ret;							\
+	if (!(_check))								\
+		return -EINVAL;							\
+	mutex_lock(&par->hw_lock);						\
+	par->bus_cfg._field = val;						\
+	lcd_controller_bus_setup(par->lcdif, &par->bus_cfg);			\
+	mutex_unlock(&par->hw_lock);						\
+	return count;								\
+}										\
+static DEVICE_ATTR_RW(_name)
+
+LCD_BUS_CFG_ATTR(panic_threshold, panic_thres, val <= THRES_PANIC_MASK);
+LCD_BUS_CFG_ATTR(fastclock_threshold, fastclock_thres, val <= THRES_FASTCLOCK_MAX);
+LCD_BUS_CFG_ATTR(burst_length, burst_len, val == 8 || val == 16);
+LCD_BUS_CFG_ATTR(outstanding_requests, outstanding_reqs, lcd_outstanding_to_field(val) >= 0);
+LCD_BUS_CFG_ATTR(recover_on_underflow, recover_on_underflow, val <= 1);
+
+#define LCD_COUNTER_ATTR(_name, _field)						\
+static ssize_t _name##_show(struct device *dev,					\
+			    struct device_attribute *attr, char *buf)		\
+{										\
+	return sprintf(buf, "%d\n", atomic_read(&lcd_dev_to_par(dev)->_field));	\
+}										\
+static ssize_t _name##_store(struct device *dev,				\
+			     struct device_attribute *attr,			\
+			     const char *buf, size_t count)			\
+{										\
+	unsigned int val;							\
+	int ret = kstrtouint(buf, 0, &val);					\
+										\
+	if (ret)								\
+		return ret;							\
+	if (val)								\
+		return -EINVAL;							\
+	atomic_set(&lcd_dev_to_par(dev)->_field, 0);				\
+	return count;								\
+}										\
+static DEVICE_ATTR_RW(_name)
+
+LCD_COUNTER_ATTR(underflow_count, underflow_cnt);
+LCD_COUNTER_ATTR(overflow_count, overflow_cnt);
+LCD_COUNTER_ATTR(frame_count, frame_cnt);
+
+/*
+ * CPU旋转
+ * 显存是写合并(不经cache)的内存, 按列读取时每个像素都是一次单独的总线读;
+ * 所以先把源数据按行突发拷贝到可缓存的scratch中, 再从scratch转置,
+ * 按目的行顺序写入扫描buffer, 读写都是连续的突发访问
+ * 90/270度: 每次处理LCD_ROT_STRIP个目的行, 对应源画面中同样宽度的一个竖条
+ * sw/sh: 源(旋转后画面)的宽高, 目的为面板方向
+ */
+#define LCD_DEFINE_ROTATE(bits)								\
+static void lcd_rotate_cpu_##bits(void *dst_base, unsigned int dst_stride,		\
+				  const void *src_base, unsigned int src_stride,	\
+				  unsigned int sw, unsigned int sh, int rotate,		\
+				  u##bits *tmp)						\
+{											\
+	unsigned int dw = sh, dh = sw;	/* 90/270度 */					\
+	unsigned int ty, n, x0, px, py, y;						\
+											\
+	if (rotate == FB_ROTATE_UD) {							\
+		/* 目的第py行是源第sh-1-py行的逆序 */				\
+		for (py = 0; py < sh; py++) {						\
+			u##bits *dst = dst_base + py * dst_stride;			\
+											\
+			memcpy(tmp, src_base + (sh - 1 - py) * src_stride, sw * (bits / 8)); \
+			for (px = 0; px < sw; px++)					\
+				dst[px] = tmp[sw - 1 - px];				\
+		}									\
+		return;									\
+	}										\
+											\
+	for (ty = 0; ty < dh; ty += LCD_ROT_STRIP) {					\
+		n = min(LCD_ROT_STRIP, dh - ty);					\
+		/* 目的行[ty, ty+n)来自源中的列[x0, x0+n) */			\
+		x0 = (rotate == FB_ROTATE_CW) ? ty : sw - ty - n;			\
+		for (y = 0; y < sh; y++)						\
+			memcpy(tmp + y * n, src_base + y * src_stride + x0 * (bits / 8), \
+			       n * (bits / 8));						\
+											\
+		for (py = ty; py < ty + n; py++) {					\
+			u##bits *dst = dst_base + py * dst_stride;			\
+											\
+			if (rotate == FB_ROTATE_CW) {	/* 源(x,y) -> 面板(sh-1-y, x) */ \
+				for (px = 0; px < dw; px++)				\
+					dst[px] = tmp[(sh - 1 - px) * n + (py - x0)];	\
+			} else {			/* 源(x,y) -> 面板(y, sw-1-x) */ \
+				for (px = 0; px < dw; px++)				\
+					dst[px] = tmp[px * n + (sw - 1 - py - x0)];	\
+			}							\
+		}								\
+	}										\
+}
+
+LCD_DEFINE_ROTATE(16)
+LCD_DEFINE_ROTATE(32)
+
+#if IS_ENABLED(CONFIG_MXC_PXP_V2) || IS_ENABLED(CONFIG_MXC_PXP_V3)
+static bool lcd_pxp_chan_filter(struct dma_chan *chan, void *arg)
+{
+	return imx_dma_is_pxp(chan);
+}
+
+static void lcd_pxp_dma_done(void *arg)
+{
+	struct mylcd_par *par = arg;
+
+	complete(&par->rot.pxp_done);
+}
+
+/* 申请PXP通道, 失败时使用CPU旋转; 每个实例使用自己的通道 */
+static void lcd_pxp_init(struct mylcd_par *par)
+{
+	struct lcd_rotate_state *rot = &par->rot;
+	dma_cap_mask_t mask;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_SLAVE, mask);
+	dma_cap_set(DMA_PRIVATE, mask);
+	rot->pxp_chan = dma_request_channel(mask, lcd_pxp_chan_filter, NULL);
+	if (!rot->pxp_chan) {
+		dev_info(par->dev, "no PXP channel, rotating on the CPU\n");
+		return;
+	}
+	init_completion(&rot->pxp_done);
+	rot->use_pxp = true;
+}
+
+static void lcd_pxp_release(struct mylcd_par *par)
+{
+	if (par->rot.pxp_chan)
+		dma_release_channel(par->rot.pxp_chan);
+	par->rot.pxp_chan = NULL;
+	par->rot.use_pxp = false;
+}
+
+/* 用PXP把src旋转到dst, 阻塞直到完成 */
+static int lcd_rotate_pxp(struct mylcd_par *par, dma_addr_t dst, dma_addr_t src,
+			  struct fb_var_screeninfo *var)
+{
+	struct pxp_config_data pxp_conf;
+	struct dma_async_tx_descriptor *txd;
+	struct pxp_tx_desc *desc;
+	struct scatterlist sg[2];
+	unsigned int pix_fmt = var->bits_per_pixel == 16 ? PXP_PIX_FMT_RGB565 : PXP_PIX_FMT_XRGB32;
+	int i, length;
+
+	memset(&pxp_conf, 0, sizeof(pxp_conf));
+	pxp_conf.s0_param.width = var->xres;
+	pxp_conf.s0_param.height = var->yres;
+	pxp_conf.s0_param.stride = var->xres_virtual;
+	pxp_conf.s0_param.pixel_fmt = pix_fmt;
+	pxp_conf.out_param.width = par->panel_xres;
+	pxp_conf.out_param.height = par->panel_yres;
+	pxp_conf.out_param.stride = par->panel_xres;
+	pxp_conf.out_param.pixel_fmt = pix_fmt;
+	pxp_conf.proc_data.rotate = var->rotate * 90;
+	pxp_conf.proc_data.srect.width = var->xres;
+	pxp_conf.proc_data.srect.height = var->yres;
+	pxp_conf.proc_data.drect.width = par->panel_xres;
+	pxp_conf.proc_data.drect.height = par->panel_yres;
+
+	sg_init_table(sg, 2);
+	sg_dma_address(&sg[0]) = src;
+	sg_dma_address(&sg[1]) = dst;
+
+	txd = dmaengine_prep_slave_sg(par->rot.pxp_chan, sg, 2, DMA_TO_DEVICE, DMA_PREP_INTERRUPT);
+	if (!txd)
+		return -EIO;
+	txd->callback = lcd_pxp_dma_done;
+	txd->callback_param = par;
+
+	/* 第一个描述符带S0层参数, 第二个带输出层参数 */
+	desc = to_tx_desc(txd);
+	length = desc->len;
+	for (i = 0; i < length; i++) {
+		if (i == 0) {
+			memcpy(&desc->proc_data, &pxp_conf.proc_data, sizeof(struct pxp_proc_data));
+			pxp_conf.s0_param.paddr = src;
+			memcpy(&desc->layer_param.s0_param, &pxp_conf.s0_param, sizeof(struct pxp_layer_param));
+		} else if (i == 1) {
+			pxp_conf.out_param.paddr = dst;
+			memcpy(&desc->layer_param.out_param, &pxp_conf.out_param, sizeof(struct pxp_layer_param));
+		}
+		desc = desc->next;
+	}
+
+	reinit_completion(&par->rot.pxp_done);
+	if (dma_submit_error(dmaengine_submit(txd)))
+		return -EIO;
+	dma_async_issue_pending(par->rot.pxp_chan);
+
+	if (!wait_for_completion_timeout(&par->rot.pxp_done, msecs_to_jiffies(100)))
+		return -ETIMEDOUT;
+	return 0;
+}
+#else
+static void lcd_pxp_init(struct mylcd_par *par)
+{
+	dev_info(par->dev, "PXP support not built, rotating on the CPU\n");
+}
+
+static void lcd_pxp_release(struct mylcd_par *par)
+{
+}
+
+static int lcd_rotate_pxp(struct mylcd_par *par, dma_addr_t dst, dma_addr_t src,
+			  struct fb_var_screeninfo *var)
+{
+	return -ENODEV;
+}
+#endif
+
+/* 分配面板方向的扫描buffer和CPU旋转用的scratch, 只在第一次使用旋转时分配 */
+static int lcd_rotate_alloc(struct fb_info *info)
+{
+	struct mylcd_par *par = info->par;
+	struct lcd_rotate_state *rot = &par->rot;
+	unsigned int bytes = info->var.bits_per_pixel / 8;
+	size_t size = par->panel_xres * par->panel_yres * bytes;
+	size_t scratch_size = max(par->panel_xres, par->panel_yres) * LCD_ROT_STRIP * bytes;
+	int i;
+
+	if (rot->buf[0] && rot->size >= size && rot->scratch_size >= scratch_size)
+		return 0;
+	for (i = 0; i < LCD_ROT_BUFFERS; i++) {
+		if (rot->buf[i])
+			dma_free_wc(par->dev, rot->size, rot->buf[i], rot->phys[i]);
+		rot->buf[i] = dma_alloc_wc(par->dev, size, &rot->phys[i], GFP_KERNEL);
+		if (!rot->buf[i])
+			return -ENOMEM;
+	}
+	rot->size = size;
+
+	vfree(rot->scratch);
+	rot->scratch = vmalloc(scratch_size);
+	if (!rot->scratch)
+		return -ENOMEM;
+	rot->scratch_size = scratch_size;
+	return 0;
+}
+
+static void lcd_rotate_free(struct mylcd_par *par)
+{
+	struct lcd_rotate_state *rot = &par->rot;
+	int i;
+
+	for (i = 0; i < LCD_ROT_BUFFERS; i++) {
+		if (rot->buf[i])
+			dma_free_wc(par->dev, rot->size, rot->buf[i], rot->phys[i]);
+		rot->buf[i] = NULL;
+	}
+	rot->size = 0;
+	vfree(rot->scratch);
+	rot->scratch = NULL;
+	rot->scratch_size = 0;
+}
+
+/*
+ * 找一个可以写入的扫描buffer: 不在扫描(CUR_BUF), 不等待生效(NEXT_BUF), 也不在显示队列中
+ * 返回下标, 没有时返回-1; 调用者持有present.lock
+ */
+static int lcd_rotate_pick(struct mylcd_par *par)
+{
+	struct lcd_present_queue *present = &par->present;
+	struct lcd_rotate_state *rot = &par->rot;
+	dma_addr_t cur = par->lcdif->CUR_BUF, next = par->lcdif->NEXT_BUF;
+	unsigned int i, k;
+
+	for (i = 0; i < LCD_ROT_BUFFERS; i++) {
+		if (rot->phys[i] == cur || rot->phys[i] == next)
+			continue;
+		for (k = 0; k < present->count; k++)
+			if (present->q[(present->head + k) % LCD_PRESENT_QUEUE].addr == rot->phys[i])
+				break;
+		if (k == present->count)
+			return i;
+	}
+	return -1;
+}
+
+/* 把显存中yoffset处的画面旋转到第index个扫描buffer, 返回其物理地址; 可能睡眠 */
+static dma_addr_t lcd_rotate_frame(struct fb_info *info, unsigned int yoffset, int index)
+{
+	struct mylcd_par *par = info->par;
+	struct lcd_rotate_state *rot = &par->rot;
+	struct fb_var_screeninfo *var = &info->var;
+	struct lcd_rotate_stat *stat = &rot->stat[var->rotate & 3];
+	unsigned int line_length = info->fix.line_length;
+	unsigned int dst_stride = par->panel_xres * var->bits_per_pixel / 8;
+	dma_addr_t src_phys = info->fix.smem_start + yoffset * line_length;
+	void *src = info->screen_base + yoffset * line_length;
+	ktime_t start = ktime_get();
+	u64 ns;
+
+	if (!rot->use_pxp || lcd_rotate_pxp(par, rot->phys[index], src_phys, var)) {
+		if (var->bits_per_pixel == 16)
+			lcd_rotate_cpu_16(rot->buf[index], dst_stride, src, line_length,
+					  var->xres, var->yres, var->rotate, rot->scratch);
+		else
+			lcd_rotate_cpu_32(rot->buf[index], dst_stride, src, line_length,
+					  var->xres, var->yres, var->rotate, rot->scratch);
+	}
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	stat->count++;
+	stat->last_ns = ns;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+	return rot->phys[index];
+}
+
+/* 按bpp设置位域: 8bpp为调色板索引, 16bpp为RGB565 */
+static void lcd_var_set_format(struct fb_var_screeninfo *var, unsigned int bpp)
+{
+	memset(&var->red, 0, sizeof(var->red));
+	memset(&var->green, 0, sizeof(var->green));
+	memset(&var->blue, 0, sizeof(var->blue));
+	memset(&var->transp, 0, sizeof(var->transp));
+
+	var->bits_per_pixel = bpp;
+	if (bpp == 8) {
+		var->red.length = 8;
+		var->green.length = 8;
+		var->blue.length = 8;
+	} else {
+		var->red.offset = 11;
+		var->red.length = 5;
+		var->green.offset = 5;
+		var->green.length = 6;
+		var->blue.offset = 0;
+		var->blue.length = 5;
+	}
+}
+
+/* 检查应用设置的参数: 支持8/16bpp, 0/90/180/270度旋转和多buffer */
+static int myLCD_check_var(struct fb_var_screeninfo *var, struct fb_info *info)
+{
+	struct mylcd_par *par = info->par;
+	unsigned int max_yres_virtual;
+
+	if (var->rotate > FB_ROTATE_CCW)
+		return -EINVAL;
+	if (var->bits_per_pixel != 8 && var->bits_per_pixel != 16)
+		return -EINVAL;
+	/* PXP和CPU旋转都不处理调色板格式 */
+	if (var->bits_per_pixel == 8 && var->rotate != FB_ROTATE_UR)
+		return -EINVAL;
+
+	/* 90/270度时宽高互换 */
+	if (var->rotate == FB_ROTATE_CW || var->rotate == FB_ROTATE_CCW) {
+		var->xres = par->panel_yres;
+		var->yres = par->panel_xres;
+	} else {
+		var->xres = par->panel_xres;
+		var->yres = par->panel_yres;
+	}
+	var->xres_virtual = var->xres;
+	max_yres_virtual = info->fix.smem_len / (var->xres * var->bits_per_pixel / 8);
+	if (var->yres_virtual < var->yres)
+		var->yres_virtual = var->yres;
+	if (var->yres_virtual > max_yres_virtual)
+		var->yres_virtual = max_yres_virtual;
+	if (var->yoffset + var->yres > var->yres_virtual)
+		var->yoffset = 0;
+	var->xoffset = 0;
+
+	lcd_var_set_format(var, var->bits_per_pixel);
+	return 0;
+}
+
+/*
+ * 旋转的工作队列
+ * 有pan时旋转最后一次pan的画面并以mailbox方式提交;
+ * 没有pan时是定时刷新: 重新旋转当前画面直接写入NEXT_BUF, 不产生新的序号,
+ * 应用在用异步显示(队列非空)时跳过, 不打乱它的帧
+ */
+static void lcd_rotate_work(struct work_struct *work)
+{
+	struct lcd_rotate_state *rot = container_of(to_delayed_work(work),
+						    struct lcd_rotate_state, work);
+	struct mylcd_par *par = container_of(rot, struct mylcd_par, rot);
+	struct lcd_present_queue *present = &par->present;
+	struct fb_info *info = par->info;
+	unsigned long flags;
+	unsigned int yoffset;
+	dma_addr_t addr;
+	bool pan;
+	int index;
+
+	mutex_lock(&rot->lock);
+	if (info->var.rotate == FB_ROTATE_UR || !rot->buf[0])
+		goto out;
+
+	spin_lock_irqsave(&present->lock, flags);
+	pan = rot->pan_pending;
+	rot->pan_pending = false;
+	yoffset = rot->yoffset;
+	index = -1;
+	if (pan) {
+		/* mailbox会丢弃排队的帧, 现在就丢弃, 它们的扫描buffer可以重用 */
+		present->count = 0;
+		index = lcd_rotate_pick(par);
+	} else if (!present->has_pending && !present->count) {
+		index = lcd_rotate_pick(par);
+	}
+	spin_unlock_irqrestore(&present->lock, flags);
+
+	if (index >= 0) {
+		addr = lcd_rotate_frame(info, yoffset, index);
+		if (pan) {
+			lcd_present_submit(&par->present, addr, true, NULL);
+		} else {
+			spin_lock_irqsave(&present->lock, flags);
+			if (!present->has_pending && !present->count && !rot->pan_pending)
+				par->lcdif->NEXT_BUF = addr;
+			spin_unlock_irqrestore(&present->lock, flags);
+		}
+	}
+	if (rotate_refresh_ms)
+		schedule_delayed_work(&rot->work, msecs_to_jiffies(rotate_refresh_ms));
+out:
+	mutex_unlock(&rot->lock);
+}
+
+/* 旋转时的MYLCDIO_PRESENT: 在调用者的上下文中旋转(可以睡眠), 再按顺序排队 */
+static int lcd_rotate_present(struct mylcd_par *par, unsigned int yoffset, u64 *seqno)
+{
+	struct lcd_present_queue *present = &par->present;
+	struct lcd_rotate_state *rot = &par->rot;
+	unsigned long flags;
+	dma_addr_t addr;
+	int index, ret;
+
+	mutex_lock(&rot->lock);
+	spin_lock_irqsave(&present->lock, flags);
+	index = lcd_rotate_pick(par);
+	if (index >= 0 && !rot->pan_pending)
+		rot->yoffset = yoffset;
+	spin_unlock_irqrestore(&present->lock, flags);
+
+	if (index < 0) {
+		/* 三个扫描buffer都在使用: 扫描、等待生效和排队各一个 */
+		ret = -EBUSY;
+	} else {
+		addr = lcd_rotate_frame(par->info, yoffset, index);
+		ret = lcd_present_submit(&par->present, addr, false, seqno);
+	}
+	mutex_unlock(&rot->lock);
+	return ret;
+}
+
+/*
+ * 切换显示buffer: 把yoffset处的画面地址写入NEXT_BUF, 下一帧生效
+ * 不睡眠: 旋转时只记录yoffset, 由工作队列旋转后提交
+ */
+static int myLCD_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
+{
+	struct mylcd_par *par = info->par;
+	struct lcd_present_queue *present = &par->present;
+	unsigned long flags;
+
+	if (info->var.rotate == FB_ROTATE_UR)
+		return lcd_present_submit(&par->present, info->fix.smem_start +
+					  var->yoffset * info->fix.line_length, true, NULL);
+
+	spin_lock_irqsave(&present->lock, flags);
+	par->rot.yoffset = var->yoffset;
+	par->rot.pan_pending = true;
+	spin_unlock_irqrestore(&present->lock, flags);
+	mod_delayed_work(system_wq, &par->rot.work, 0);
+	return 0;
+}
+
+/* 私有ioctl: 异步显示和fence */
+static int myLCD_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
+{
+	struct mylcd_par *par = info->par;
+	void __user *argp = (void __user *)arg;
+	struct mylcd_present req;
+	int ret;
+
+	if (cmd != MYLCDIO_PRESENT)
+		return lcd_present_ioctl(&par->present, cmd, argp);
+
+	if (copy_from_user(&req, argp, sizeof(req)))
+		return -EFAULT;
+	/* flags保留给以后使用, 现在必须为0; yoffset不能用加法比较, 很大的值会回绕 */
+	if (req.flags || req.yoffset > info->var.yres_virtual - info->var.yres)
+		return -EINVAL;
+	if (info->var.rotate == FB_ROTATE_UR)
+		ret = lcd_present_submit(&par->present, info->fix.smem_start +
+					 req.yoffset * info->fix.line_length,
+					 false, &req.seqno);
+	else
+		ret = lcd_rotate_present(par, req.yoffset, &req.seqno);
+	if (ret)
+		return ret;
+	info->var.yoffset = req.yoffset;
+	return copy_to_user(argp, &req, sizeof(req)) ? -EFAULT : 0;
+}
+
+
+/* 使参数生效 */
+static int myLCD_set_par(struct fb_info *info)
+{
+	struct mylcd_par *par = info->par;
+	struct fb_var_screeninfo *var = &info->var;
+	int ret;
+
+	info->fix.line_length = var->xres_virtual * var->bits_per_pixel / 8;
+	info->fix.visual = (var->bits_per_pixel == 8) ? FB_VISUAL_PSEUDOCOLOR : FB_VISUAL_TRUECOLOR;
+	mutex_lock(&par->hw_lock);
+	if (var->bits_per_pixel != par->fb_bpp)
+		lcd_controller_set_fb_format(par, var->bits_per_pixel);
+	mutex_unlock(&par->hw_lock);
+
+	if (var->rotate != FB_ROTATE_UR) {
+		mutex_lock(&par->rot.lock);
+		ret = lcd_rotate_alloc(info);
+		mutex_unlock(&par->rot.lock);
+		if (ret)
+			return ret;
+	} else {
+		/* 不再旋转: 停止定时刷新, 之后的pan直接送显 */
+		cancel_delayed_work_sync(&par->rot.work);
+	}
+	return myLCD_pan_display(var, info);
+}
+
+/* /sys/.../rotate_stats: 每个角度的旋转次数和每帧耗时(us) */
+static ssize_t rotate_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	static const char * const names[] = { "0", "90", "180", "270" };
+	struct lcd_rotate_state *rot = &lcd_dev_to_par(dev)->rot;
+	ssize_t len;
+	int i;
+
+	len = sprintf(buf, "engine: %s\n", rot->use_pxp ? "pxp" : "cpu");
+	for (i = 0; i < 4; i++) {
+		struct lcd_rotate_stat *stat = &rot->stat[i];
+
+		len += sprintf(buf + len, "%s: frames %u last %llu us avg %llu us max %llu us\n",
+			       names[i], stat->count, stat->last_ns / 1000,
+			       stat->count ? div_u64(stat->total_ns, stat->count) / 1000 : 0,
+			       stat->max_ns / 1000);
+	}
+	return len;
+}
+
+/* 写入任意值清零统计 */
+static ssize_t rotate_stats_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct lcd_rotate_state *rot = &lcd_dev_to_par(dev)->rot;
+
+	memset(rot->stat, 0, sizeof(rot->stat));
+	return count;
+}
+static DEVICE_ATTR_RW(rotate_stats);
+
+/* /sys/.../rotate_use_pxp: 1使用PXP, 0强制CPU旋转, 便于对比 */
+static ssize_t rotate_use_pxp_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lcd_dev_to_par(dev)->rot.use_pxp);
+}
+
+static ssize_t rotate_use_pxp_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct lcd_rotate_state *rot = &lcd_dev_to_par(dev)->rot;
+	bool val;
+	int ret = kstrtobool(buf, &val);
+
+	if (ret)
+		return ret;
+	if (val && !rot->pxp_chan)
+		return -ENODEV;
+	rot->use_pxp = val;
+	return count;
+}
+static DEVICE_ATTR_RW(rotate_use_pxp);
+
+/* /sys/.../scanout_bandwidth: 当前格式下控制器每秒从DDR读取的字节数 */
+static ssize_t scanout_bandwidth_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct mylcd_par *par = lcd_dev_to_par(dev);
+	unsigned int bpp = par->info->var.bits_per_pixel;
+	unsigned int frame = par->panel_xres * par->panel_yres * bpp / 8;
+
+	return sprintf(buf, "%ubpp %u bytes/frame %u Hz %u KB/s\n", bpp, frame,
+		       par->frame_hz, frame / 1024 * par->frame_hz);
+}
+static DEVICE_ATTR_RO(scanout_bandwidth);
+
+/*
+ * /sys/.../probe_timing: probe各阶段相对开始的时间(us)
+ * start一行是probe开始时距离开机的时间, 相加即为开机到第一帧的时间
+ */
+static ssize_t probe_timing_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mylcd_par *par = lcd_dev_to_par(dev);
+	ssize_t len;
+	int i;
+
+	len = sprintf(buf, "%-12s %lld us since boot\n", lcd_stage_names[LCD_STAGE_START],
+		      ktime_to_us(par->probe_ts[LCD_STAGE_START]));
+	for (i = LCD_STAGE_START + 1; i < LCD_STAGE_NUM; i++)
+		len += sprintf(buf + len, "%-12s %lld us\n", lcd_stage_names[i],
+			       lcd_probe_delta_us(par, i));
+	return len;
+}
+static DEVICE_ATTR_RO(probe_timing);
+
+static struct attribute *myLCD_attrs[] = {
+	&dev_attr_panic_threshold.attr,
+	&dev_attr_fastclock_threshold.attr,
+	&dev_attr_burst_length.attr,
+	&dev_attr_outstanding_requests.attr,
+	&dev_attr_recover_on_underflow.attr,
+	&dev_attr_underflow_count.attr,
+	&dev_attr_overflow_count.attr,
+	&dev_attr_frame_count.attr,
+	&dev_attr_rotate_stats.attr,
+	&dev_attr_rotate_use_pxp.attr,
+	&dev_attr_scanout_bandwidth.attr,
+	&dev_attr_probe_timing.attr,
+	NULL,
+};
+
+static const struct attribute_group myLCD_attr_group = {
+	.attrs = myLCD_attrs,
+};
+
 
 
 
@@ -275,6 +1329,7 @@ static inline u_int chan_to_field(u_int chan, struct fb_bitfield *bf)
 static int myLCD_setcolreg(u_int regno, u_int red, u_int green, 
 							u_int blue,u_int trans, struct fb_info *info)
 {
+	struct mylcd_par *par = info->par;
 	unsigned int val;
 	int ret = 1;
 	switch (info->fix.visual) {
@@ -293,60 +1348,194 @@ static int myLCD_setcolreg(u_int regno, u_int red, u_int green,
 			ret = 0;
 		}
 		break;
+	case FB_VISUAL_PSEUDOCOLOR://调色板
+		/*
+		 * 8位索引模式: 写入控制器的LUT0, 扫描时由硬件展开为24位RGB。
+		 */
+		if (regno < 256) {
+			val = ((red >> 8) << 16) | ((green >> 8) << 8) | (blue >> 8);
+			par->lut_shadow[regno] = val;
+			par->lcdif->LUT0_ADDR = regno;
+			par->lcdif->LUT0_DATA = val;
+			ret = 0;
+		}
+		break;
 	}
 
 	return ret;
 }
-		   
+
+/*
+ * 画图: fbcon输出字符时调用, image是1bpp的字形位图
+ * 单色位图用查表展开, 其他情况交给通用的cfb_imageblit
+ */
+static void myLCD_imageblit(struct fb_info *info, const struct fb_image *image)
+{
+	struct mylcd_par *par = info->par;
+	unsigned int bpp = info->var.bits_per_pixel;
+	u32 fg, bg;
+	void *dst;
+
+	if (info->state != FBINFO_STATE_RUNNING)
+		return;
+	if (image->depth != 1 || (bpp != 16 && bpp != 32)) {
+		cfb_imageblit(info, image);
+		return;
+	}
+
+	if (info->fix.visual == FB_VISUAL_TRUECOLOR ||
+	    info->fix.visual == FB_VISUAL_DIRECTCOLOR) {
+		fg = ((u32 *)info->pseudo_palette)[image->fg_color];
+		bg = ((u32 *)info->pseudo_palette)[image->bg_color];
+	} else {
+		fg = image->fg_color;
+		bg = image->bg_color;
+	}
+	lcd_expand_table_update(&par->blit_tab, fg, bg, bpp);
+
+	dst = (void __force *)info->screen_base + image->dy * info->fix.line_length +
+	      image->dx * (bpp / 8);
+	lcd_expand_mono(&par->blit_tab, dst, info->fix.line_length, (const u8 *)image->data,
+			DIV_ROUND_UP(image->width, 8), image->width, image->height);
+}
+
 static struct fb_ops myLCD_ops = {
 	.owner		= THIS_MODULE,
+	.fb_check_var	= myLCD_check_var,
+	.fb_set_par	= myLCD_set_par,
 	.fb_setcolreg	= myLCD_setcolreg,
+	.fb_pan_display	= myLCD_pan_display,
+	.fb_ioctl	= myLCD_ioctl,
 	.fb_fillrect	= cfb_fillrect,
 	.fb_copyarea	= cfb_copyarea,
-	.fb_imageblit	= cfb_imageblit,
+	.fb_imageblit	= myLCD_imageblit,
 };
 
-
-int myLCD_probe(struct platform_device *pdev)
+/*
+ * 从设备树读取面板参数和时序
+ * 内存实例没有设备树节点, 使用默认时序
+ */
+static int lcd_parse_display(struct platform_device *pdev, struct mylcd_par *par,
+			     unsigned int *lcd_bpp, unsigned int *fb_bpp)
 {
-	struct resource *res;
 	struct device_node *display_np;
-	dma_addr_t phy_addr;
-	struct display_timings *timings = NULL;//所有的显示时序
-	struct display_timing *dt = NULL;//当前使用的显示时序
-	unsigned int bits_per_pixel;
-	unsigned int bus_width = 0;
-	
-
-	
-	/* 从设备树中获取gpio信息 配置gpio为输出*/
-	bl_gpio = gpiod_get(&pdev->dev, "backlight", GPIOD_OUT_HIGH);
-	gpiod_direction_output(bl_gpio, 1);
-	
+	struct display_timings *timings;//所有的显示时序
+
+	*lcd_bpp = 24;
+	*fb_bpp = 16;
+	if (!pdev->dev.of_node) {
+		par->timing = lcd_default_timing;
+		return 0;
+	}
+
 	/* 将"display"属性做为设备节点指针 */
 	display_np = of_parse_phandle(pdev->dev.of_node, "display", 0);
-	
+	if (!display_np)
+		return -ENODEV;
+
 	/* 获取通用信息 */
-	of_property_read_u32(display_np, "bits-per-pixel", &bits_per_pixel);
-	of_property_read_u32(display_np, "bus-width", &bus_width);
-	
+	of_property_read_u32(display_np, "bits-per-pixel", lcd_bpp);
+	/* fb的像素位数: 16(RGB565) 或 8(调色板) */
+	of_property_read_u32(display_np, "fb-bits-per-pixel", fb_bpp);
+	if (*fb_bpp != 8 && *fb_bpp != 16)
+		*fb_bpp = 16;
+
 	/* 解析设备节点中display_timings项的所有内容 */
 	timings = of_get_display_timings(display_np);
-	/* 获取当前的设备时序 native-mode = <&timing0>;*/
-	dt = timings->timings[timings->native_mode];
-	/* 解析时钟pix和axi节点信息      		clock-names = "pix", "axi"; */
-	clk_pix = devm_clk_get(&pdev->dev, "pix");
-	clk_axi = devm_clk_get(&pdev->dev, "axi");
-	/* 设置LCD像素时钟 */
-	clk_set_rate(clk_pix, dt->pixelclock.typ);
-
-	/* 时钟使能 */
-	clk_prepare_enable(clk_axi);
-	clk_prepare_enable(clk_pix);
-	
-	/* 分配fb_info结构体 */
-	fb_info = framebuffer_alloc(0, NULL);
+	of_node_put(display_np);
+	if (!timings)
+		return -EINVAL;
+	/* 获取当前的设备时序 native-mode = <&timing0>; 复制后释放 */
+	par->timing = *timings->timings[timings->native_mode];
+	display_timings_release(timings);
+	return 0;
+}
+
+/* 由时序计算刷新率 */
+static unsigned int lcd_timing_refresh(const struct display_timing *dt)
+{
+	unsigned int htotal = dt->hactive.typ + dt->hfront_porch.typ + dt->hback_porch.typ + dt->hsync_len.typ;
+	unsigned int vtotal = dt->vactive.typ + dt->vfront_porch.typ + dt->vback_porch.typ + dt->vsync_len.typ;
+
+	return dt->pixelclock.typ / (htotal * vtotal);
+}
+
+int myLCD_probe(struct platform_device *pdev)
+{
+	struct fb_info *fb_info;
+	struct mylcd_par *par;
+	struct resource *res;
+	dma_addr_t phy_addr;
+	struct display_timing *dt;//当前使用的显示时序
+	unsigned int bits_per_pixel;
+	unsigned int fb_bpp;
+	ktime_t start = ktime_get();
+	int irq;
+	int ret;
+
+	/* 分配fb_info结构体, 私有数据紧跟在后面 */
+	fb_info = framebuffer_alloc(sizeof(struct mylcd_par), &pdev->dev);
+	if (!fb_info)
+		return -ENOMEM;
+	par = fb_info->par;
+	par->info = fb_info;
+	par->dev = &pdev->dev;
+	par->probe_ts[LCD_STAGE_START] = start;
+	lcd_present_init(&par->present, lcd_next_buf_program);
+	mutex_init(&par->rot.lock);
+	mutex_init(&par->hw_lock);
+	INIT_DELAYED_WORK(&par->rot.work, lcd_rotate_work);
+	atomic_set(&par->underflow_cnt, 0);
+	atomic_set(&par->overflow_cnt, 0);
+	atomic_set(&par->frame_cnt, 0);
+	platform_set_drvdata(pdev, fb_info);
+
+	/* 没有寄存器资源的是内存实例 */
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);//reg = <0x021c8000 0x4000>;
+	par->mem_backed = !res;
+
+	/* 从设备树中获取gpio信息, 先关背光, 第一帧开始扫描后再打开; 没有背光脚时为NULL */
+	par->bl_gpio = devm_gpiod_get_optional(&pdev->dev, "backlight", GPIOD_OUT_LOW);
+	if (IS_ERR(par->bl_gpio)) {
+		ret = PTR_ERR(par->bl_gpio);
+		goto err_release;
+	}
+
+	ret = lcd_parse_display(pdev, par, &bits_per_pixel, &fb_bpp);
+	if (ret) {
+		dev_err(&pdev->dev, "can't get display timings\n");
+		goto err_release;
+	}
+	dt = &par->timing;
+	par->frame_hz = lcd_timing_refresh(dt);
+	lcd_probe_stamp(par, LCD_STAGE_TIMINGS);
+
+	if (!par->mem_backed) {
+		/* 解析时钟pix和axi节点信息      		clock-names = "pix", "axi"; */
+		par->clk_pix = devm_clk_get(&pdev->dev, "pix");
+		par->clk_axi = devm_clk_get(&pdev->dev, "axi");
+		if (IS_ERR(par->clk_pix) || IS_ERR(par->clk_axi)) {
+			ret = -ENODEV;
+			goto err_release;
+		}
+		/* 设置LCD像素时钟 */
+		clk_set_rate(par->clk_pix, dt->pixelclock.typ);
+
+		/* 时钟使能 */
+		ret = clk_prepare_enable(par->clk_axi);
+		if (ret)
+			goto err_release;
+		ret = clk_prepare_enable(par->clk_pix);
+		if (ret)
+			goto err_clk;
+	}
+	lcd_probe_stamp(par, LCD_STAGE_CLOCKS);
+
 	/* 1.2 设置fb_info */
+	par->panel_xres = dt->hactive.typ;
+	par->panel_yres = dt->vactive.typ;
+	/* 模块参数只读, 每个实例保存自己的值, 不影响其他实例 */
+	par->nbuffers = max(nbuffers, 1U);
 	fb_info->var.xres = fb_info->var.xres_virtual = dt->hactive.typ;//x方向分辨率
 	fb_info->var.yres = fb_info->var.yres_virtual = dt->vactive.typ;//y方向分辨率
 
@@ -370,49 +1559,203 @@ int myLCD_probe(struct platform_device *pdev)
 	else if(fb_info->var.bits_per_pixel == 24){//RGB888
 		fb_info->fix.smem_len = fb_info->var.xres * fb_info->var.yres * 4;
 	}
+	fb_info->fix.smem_len *= par->nbuffers;//多buffer
 
-	/* fb的虚拟地址 */
-	fb_info->screen_base = dma_alloc_wc(NULL, fb_info->fix.smem_len, &phy_addr, GFP_KERNEL);
+	/*
+	 * 显存: 设备树有memory-region时从预留的内存池分配,
+	 * 启动时不需要从CMA迁移页面, 分配时间固定; 否则使用默认的CMA
+	 */
+	if (of_find_property(pdev->dev.of_node, "memory-region", NULL)) {
+		ret = of_reserved_mem_device_init(&pdev->dev);
+		if (ret)
+			dev_warn(&pdev->dev, "can't use memory-region: %d, falling back to CMA\n", ret);
+		else
+			par->has_rmem = true;
+	}
+	/* fb的虚拟地址, 分配的显存已清零 */
+	fb_info->screen_base = dma_alloc_wc(&pdev->dev, fb_info->fix.smem_len, &phy_addr, GFP_KERNEL);
+	if (!fb_info->screen_base) {
+		ret = -ENOMEM;
+		goto err_rmem;
+	}
 	fb_info->fix.smem_start = phy_addr; /* fb的物理地址 */
 	fb_info->fix.type = FB_TYPE_PACKED_PIXELS;
 	fb_info->fix.visual = FB_VISUAL_TRUECOLOR;//真彩色
-	
+
 	if(fb_info->var.bits_per_pixel == 16){//RGB565
 		fb_info->fix.line_length = fb_info->var.xres * fb_info->var.bits_per_pixel / 8;
 	}
 	else if(fb_info->var.bits_per_pixel == 24){//RGB888
 		fb_info->fix.line_length = fb_info->var.xres * 4;
 	}
-	
-	fb_info->fbops = &myLCD_ops;
-	fb_info->pseudo_palette = pseudo_palette;
+	/* 显存按RGB565分配, 8bpp时同样的显存可以容纳两倍的画面 */
+	if (fb_bpp == 8) {
+		lcd_var_set_format(&fb_info->var, 8);
+		fb_info->fix.visual = FB_VISUAL_PSEUDOCOLOR;
+		fb_info->fix.line_length = fb_info->var.xres;
+	}
+	/* 虚拟屏幕覆盖全部显存, 滚屏只需修改yoffset */
+	fb_info->var.yres_virtual = fb_info->fix.smem_len / fb_info->fix.line_length;
+	lcd_probe_stamp(par, LCD_STAGE_VRAM);
 
-	/* 1.3 注册fb_info */
-	register_framebuffer(fb_info);
-	/* 1.4 硬件操作 */
+	/*
+	 * 1.3 硬件操作: 在注册fb之前就开始扫描,
+	 * 屏幕先显示清零的显存, 不用等fbcon接管和其他驱动的probe
+	 */
 	/* 获取资源	  	res是硬件地址  */
-	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);//reg = <0x021c8000 0x4000>;
-	lcdif = devm_ioremap_resource(&pdev->dev, res);//映射成虚拟地址
+	if (par->mem_backed)
+		par->lcdif = devm_kzalloc(&pdev->dev, sizeof(*par->lcdif), GFP_KERNEL);
+	else
+		par->lcdif = devm_ioremap_resource(&pdev->dev, res);//映射成虚拟地址
+	if (IS_ERR_OR_NULL(par->lcdif)) {
+		ret = par->lcdif ? PTR_ERR(par->lcdif) : -ENOMEM;
+		goto err_vram;
+	}
 	/* LCD控制器初始化(配置lcdif寄存器) */
-	lcd_controller_init(lcdif, dt, bits_per_pixel, 16, phy_addr);
+	lcd_controller_init(par->lcdif, dt, bits_per_pixel, fb_bpp, phy_addr);
+	lcd_controller_set_fb_format(par, fb_bpp);
+	/* FIFO阈值与AXI突发参数: 复位值 -> 设备树 -> 写回控制器 */
+	lcd_bus_cfg_read_hw(par->lcdif, &par->bus_cfg);
+	lcd_bus_cfg_parse_dt(&pdev->dev, &par->bus_cfg);
+	lcd_controller_bus_setup(par->lcdif, &par->bus_cfg);
+	/* 注册中断, 用于统计underflow和驱动显示队列 */
+	irq = par->mem_backed ? -ENXIO : platform_get_irq(pdev, 0);
+	if (irq >= 0) {
+		ret = devm_request_irq(&pdev->dev, irq, lcd_irq_handler, 0, dev_name(&pdev->dev), par);
+		if (ret)
+			dev_warn(&pdev->dev, "can't request irq %d: %d\n", irq, ret);
+		else {
+			par->lcdif->CTRL1_CLR = CTRL1_IRQ_STATUS_MASK;
+			par->lcdif->CTRL1_SET = CTRL1_UNDERFLOW_IRQ_EN | CTRL1_OVERFLOW_IRQ_EN | CTRL1_CUR_FRAME_DONE_IRQ_EN;
+			par->has_irq = true;
+			par->irq = irq;
+		}
+	}
+	/* 没有中断时按刷新率模拟场同步 */
+	if (!par->has_irq) {
+		par->frame_period = ns_to_ktime(NSEC_PER_SEC / max(par->frame_hz, 1U));
+		hrtimer_init(&par->vsync_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		par->vsync_timer.function = lcd_vsync_timer_fn;
+		hrtimer_start(&par->vsync_timer, par->frame_period, HRTIMER_MODE_REL);
+	}
 	/* LCD控制器使能 */
-	lcd_controller_enable(lcdif);
+	lcd_controller_enable(par->lcdif);
+	lcd_probe_stamp(par, LCD_STAGE_SCANOUT);
 
 	/* 配置背光引脚为高电平 */
-	gpiod_set_value(bl_gpio, 1);
+	gpiod_set_value(par->bl_gpio, 1);
+
+	/* 1.4 注册fb_info, fbcon在这里接管 */
+	ret = fb_alloc_cmap(&fb_info->cmap, 256, 0);
+	if (ret)
+		goto err_stop;
+
+	fb_info->fbops = &myLCD_ops;
+	fb_info->pseudo_palette = par->pseudo_palette;
+	/*
+	 * 硬件滚屏: fbcon在虚拟屏幕内平移, 每滚一行只改CUR_BUF/NEXT_BUF, 再画出新出现的行;
+	 * 没有加速的copyarea, 写合并的显存读起来也慢, 所以不设置HWACCEL_COPYAREA/READS_FAST,
+	 * fbcon选择SCROLL_PAN_REDRAW: 平移到虚拟屏幕底部时在顶部整屏重画, 不读显存拷贝
+	 * LCDIF只能从起始地址连续读取, 不支持回绕, 所以不设置YWRAP
+	 */
+	fb_info->flags = FBINFO_DEFAULT | FBINFO_HWACCEL_YPAN;
+	fb_info->fix.ypanstep = 1;
+	fb_info->fix.ywrapstep = 0;
+
+	/* 旋转引擎: 优先使用PXP */
+	lcd_pxp_init(par);
+
+	ret = register_framebuffer(fb_info);
+	if (ret)
+		goto err_pxp;
+	lcd_probe_stamp(par, LCD_STAGE_REGISTERED);
+
+	/* sysfs属性只用于调试和统计, 创建失败不影响显示 */
+	ret = sysfs_create_group(&pdev->dev.kobj, &myLCD_attr_group);
+	if (ret)
+		dev_warn(&pdev->dev, "can't create sysfs attributes: %d\n", ret);
+	else
+		par->has_sysfs = true;
+
+	dev_info(&pdev->dev, "fb%d: %ux%u %ubpp %uHz%s\n", fb_info->node, par->panel_xres,
+		 par->panel_yres, fb_bpp, par->frame_hz, par->mem_backed ? " (memory)" : "");
+	dev_info(&pdev->dev, "probe at %lld us: timings +%lld clocks +%lld vram +%lld scanout +%lld registered +%lld us\n",
+		 ktime_to_us(start),
+		 lcd_probe_delta_us(par, LCD_STAGE_TIMINGS),
+		 lcd_probe_delta_us(par, LCD_STAGE_CLOCKS),
+		 lcd_probe_delta_us(par, LCD_STAGE_VRAM),
+		 lcd_probe_delta_us(par, LCD_STAGE_SCANOUT),
+		 lcd_probe_delta_us(par, LCD_STAGE_REGISTERED));
 	return 0;
-}
 
+err_pxp:
+	cancel_delayed_work_sync(&par->rot.work);
+	lcd_pxp_release(par);
+	lcd_rotate_free(par);
+	fb_dealloc_cmap(&fb_info->cmap);
+err_stop:
+	gpiod_set_value(par->bl_gpio, 0);
+	if (par->has_irq) {
+		/* 中断处理使用par, 必须在framebuffer_release()之前释放, 不能等devm */
+		par->lcdif->CTRL1_CLR = CTRL1_UNDERFLOW_IRQ_EN | CTRL1_OVERFLOW_IRQ_EN | CTRL1_CUR_FRAME_DONE_IRQ_EN;
+		devm_free_irq(&pdev->dev, par->irq, par);
+	} else {
+		hrtimer_cancel(&par->vsync_timer);
+	}
+	par->lcdif->CTRL_CLR = CTRL_RUN;
+err_vram:
+	dma_free_wc(&pdev->dev, fb_info->fix.smem_len, fb_info->screen_base, phy_addr);
+err_rmem:
+	if (par->has_rmem)
+		of_reserved_mem_device_release(&pdev->dev);
+	clk_disable_unprepare(par->clk_pix);
+err_clk:
+	clk_disable_unprepare(par->clk_axi);
+err_release:
+	framebuffer_release(fb_info);
+	return ret;
+}
 
 static int myLCD_remove(struct platform_device *pdev)
 {
-	/* 2.1 反注册fb_info */
+	struct fb_info *fb_info = platform_get_drvdata(pdev);
+	struct mylcd_par *par = fb_info->par;
+
+	if (par->has_sysfs)
+		sysfs_remove_group(&pdev->dev.kobj, &myLCD_attr_group);
+
+	/* 2.1 反注册fb_info, 之后不会再有ioctl/pan, 再停止旋转的工作队列 */
 	unregister_framebuffer(fb_info);
-	
-	/* 2.2 释放fb_info */
-	framebuffer_release(fb_info);
+	cancel_delayed_work_sync(&par->rot.work);
 
-	iounmap(lcdif);
+	/*
+	 * 关闭背光和中断, 停止模拟的场同步
+	 * 中断处理使用par, 而par随fb_info在下面释放, 比devm早, 所以这里就释放中断
+	 * (free_irq会等待正在执行的中断处理结束)
+	 */
+	gpiod_set_value(par->bl_gpio, 0);
+	if (par->has_irq) {
+		par->lcdif->CTRL1_CLR = CTRL1_UNDERFLOW_IRQ_EN | CTRL1_OVERFLOW_IRQ_EN | CTRL1_CUR_FRAME_DONE_IRQ_EN;
+		devm_free_irq(&pdev->dev, par->irq, par);
+	} else {
+		hrtimer_cancel(&par->vsync_timer);
+	}
+	par->lcdif->CTRL_CLR = CTRL_RUN;
+	/* 场同步已停止, 不会再通知eventfd */
+	lcd_present_release(&par->present);
+
+	lcd_pxp_release(par);
+	lcd_rotate_free(par);
+
+	fb_dealloc_cmap(&fb_info->cmap);
+	dma_free_wc(&pdev->dev, fb_info->fix.smem_len, fb_info->screen_base,
+		    fb_info->fix.smem_start);
+	if (par->has_rmem)
+		of_reserved_mem_device_release(&pdev->dev);
+	clk_disable_unprepare(par->clk_pix);
+	clk_disable_unprepare(par->clk_axi);
+	/* 2.2 释放fb_info, 寄存器映射由devm释放 */
+	framebuffer_release(fb_info);
 
 	return 0;
 }
@@ -422,7 +1765,8 @@ static int myLCD_remove(struct platform_device *pdev)
 /* lcd节点匹配表 */
 static const struct of_device_id myLCD_of_match[] = {
 	{.compatible = "100ask, lcd_drv"},
-}
+	{ /* sentinel */ }
+};
 MODULE_DEVICE_TABLE(of, myLCD_of_match);
 
 static struct platform_driver myLCD_driver = {
@@ -431,32 +1775,57 @@ static struct platform_driver myLCD_driver = {
 	.driver = {
 		   .name = "myLcd",
 		   .of_match_table = myLCD_of_match,
+		   /* 不阻塞其他驱动的probe, 屏幕的初始化与它们并行 */
+		   .probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 };
 
 
 
-
-
-/**
-标准的注册和删除 platform 驱动 替换
- 
-static void __init myLCD_init(void)// 入口函数
+/* 注册驱动, 再按mem_instances创建内存实例(按名字"myLcd"匹配) */
+static int __init myLCD_init(void)// 入口函数
 {
-	return platform_driver_register(&myLCD_driver);
+	struct platform_device_info pdevinfo = {
+		.name = "myLcd",
+		.dma_mask = DMA_BIT_MASK(32),
+	};
+	int ret, i;
+
+	ret = platform_driver_register(&myLCD_driver);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < mem_instances && i < LCD_MAX_MEM_INSTANCES; i++) {
+		pdevinfo.id = i;
+		mem_pdev[i] = platform_device_register_full(&pdevinfo);
+		if (IS_ERR(mem_pdev[i])) {
+			ret = PTR_ERR(mem_pdev[i]);
+			mem_pdev[i] = NULL;
+			goto err;
+		}
+	}
+	return 0;
+
+err:
+	while (--i >= 0)
+		platform_device_unregister(mem_pdev[i]);
+	platform_driver_unregister(&myLCD_driver);
+	return ret;
 }
 
 
-static void __exit myLCD_exit(void)// 出口函数 
+static void __exit myLCD_exit(void)// 出口函数
 {
+	int i;
+
+	for (i = 0; i < LCD_MAX_MEM_INSTANCES; i++)
+		if (mem_pdev[i])
+			platform_device_unregister(mem_pdev[i]);
 	platform_driver_unregister(&myLCD_driver);
 }
- 
+
 module_init(myLCD_init);
 module_exit(myLCD_exit);
-*/
-
-module_platform_driver(myLCD_driver);
 
 
 
@@ -464,82 +1833,3 @@ MODULE_AUTHOR("CHEN CHENG YANG");
 MODULE_AUTHOR("2594806402@qq.com");
 MODULE_DESCRIPTION("Framebuffer driver for the 7'RGBLCD");
 MODULE_LICENSE("GPL");
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -1,28 +1,32 @@
-#include <linux/busfreq-imx.h>
 #include <linux/console.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
-#include <linux/of_device.h>
-#include <linux/of_gpio.h>
-#include <linux/pm_qos.h>
-#include <linux/platform_device.h>
-#include <linux/pm_runtime.h>
 #include <linux/interrupt.h>
-#include <linux/clk.h>
 #include <linux/dma-mapping.h>
 #include <linux/io.h>
-#include <linux/pinctrl/consumer.h>
 #include <linux/fb.h>
-#include <linux/mxcfb.h>
-#include <linux/regulator/consumer.h>
 #include <linux/types.h>
-#include <linux/videodev2.h>
-#include <video/of_display_timing.h>
-#include <video/videomode.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/platform_device.h>
+
+#include "lcd_ioctl.h"
+#include "lcd_present.h"
 
-#include "mxc/mxc_dispdrv.h"
+/*
+ * 虚拟显示设备
+ * 分辨率/bpp/buffer个数由模块参数指定, 用hrtimer模拟场同步;
+ * 默认只使用普通内存, 这样翻页延迟和吞吐量测试可以在任何Linux主机上运行:
+ *	insmod lcd_driver_qemu.ko xres=1024 yres=600 bpp=16 buffers=3
+ * 在QEMU模拟的板子上指定寄存器地址, 显存地址会写入寄存器:
+ *	insmod lcd_driver_qemu.ko regs_phys=0x021c8000
+ * 显存都是普通内存(不是ioremap的), 绘图使用sys_*函数,
+ * 内核需要 CONFIG_FB_SYS_FILLRECT/COPYAREA/IMAGEBLIT 和 CONFIG_FB_SYS_FOPS
+ */
 
 struct lcd_regs {
 	volatile unsigned int fb_base_phys;	//物理基地址
@@ -31,12 +35,53 @@ struct lcd_regs {
 	volatile unsigned int fb_bpp;		//颜色位数
 };
 
+static unsigned int xres = 500;
+module_param(xres, uint, 0444);
+MODULE_PARM_DESC(xres, "horizontal resolution (default 500)");
+
+static unsigned int yres = 300;
+module_param(yres, uint, 0444);
+MODULE_PARM_DESC(yres, "vertical resolution (default 300)");
+
+static unsigned int bpp = 16;
+module_param(bpp, uint, 0444);
+MODULE_PARM_DESC(bpp, "bits per pixel, 16 or 32 (default 16)");
+
+static unsigned int buffers = 2;
+module_param(buffers, uint, 0444);
+MODULE_PARM_DESC(buffers, "number of screen buffers (default 2)");
+
+static unsigned int refresh = 60;
+module_param(refresh, uint, 0444);
+MODULE_PARM_DESC(refresh, "simulated refresh rate in Hz (default 60)");
+
+static unsigned long regs_phys;
+module_param(regs_phys, ulong, 0444);
+MODULE_PARM_DESC(regs_phys, "physical address of the emulated registers (default 0 = memory only)");
+
 static struct lcd_regs *myLCD_regs;
 
+/* 没有设备树节点, 注册一个platform设备作为DMA内存的分配者和fb的父设备 */
+static struct platform_device *myLCD_pdev;
+
 struct fb_info *fb_info;
 
 static unsigned int pseudo_palette[16];
 
+/* 显存: 有寄存器时用DMA内存(需要物理地址), 否则用vmalloc */
+static dma_addr_t fb_phys;
+static bool fb_vmalloc;
+
+/*
+ * 模拟的显示队列, 与LCDIF驱动共用lcd_present.h:
+ * 提交的帧写入模拟的NEXT_BUF, 场同步时NEXT_BUF装入CUR_BUF(有寄存器时写入寄存器)
+ */
+static struct lcd_present_queue present;
+static dma_addr_t next_buf;
+
+static struct hrtimer vsync_timer;
+static ktime_t vsync_period;
+
 /* 位域转换 */
 static inline u_int chan_to_field(u_int chan, struct fb_bitfield *bf)
 {
@@ -45,7 +90,7 @@ static inline u_int chan_to_field(u_int chan, struct fb_bitfield *bf)
 	return chan << bf->offset;
 }
 /* 设置调色板 */
-static int myLCD_setcolreg(u_int regno, u_int red, u_int green, 
+static int myLCD_setcolreg(u_int regno, u_int red, u_int green,
 							u_int blue,u_int trans, struct fb_info *info)
 {
 	unsigned int val;
@@ -70,75 +115,241 @@ static int myLCD_setcolreg(u_int regno, u_int red, u_int green,
 
 	return ret;
 }
-		   
+
+/* 显示队列的program: 写入模拟的NEXT_BUF, 调用者持有present.lock */
+static void lcd_next_buf_program(struct lcd_present_queue *present, dma_addr_t addr)
+{
+	WRITE_ONCE(next_buf, addr);
+}
+
+/* 模拟的场同步: 相当于LCDIF的帧结束中断, NEXT_BUF在这里开始扫描 */
+static enum hrtimer_restart lcd_vsync_timer_fn(struct hrtimer *timer)
+{
+	dma_addr_t cur = READ_ONCE(next_buf);
+
+	if (myLCD_regs)
+		myLCD_regs->fb_base_phys = cur;
+	lcd_present_vsync(&present, cur);
+
+	hrtimer_forward_now(timer, vsync_period);
+	return HRTIMER_RESTART;
+}
+
+/* yoffset处画面的扫描地址, vmalloc的显存没有物理地址, 相当于偏移 */
+static dma_addr_t lcd_frame_addr(struct fb_info *info, unsigned int yoffset)
+{
+	return info->fix.smem_start + yoffset * info->fix.line_length;
+}
+
+/* 检查参数: 分辨率和bpp固定, 允许在buffers个画面内平移 */
+static int myLCD_check_var(struct fb_var_screeninfo *var, struct fb_info *info)
+{
+	if (var->bits_per_pixel != info->var.bits_per_pixel || var->rotate)
+		return -EINVAL;
+
+	var->xres = var->xres_virtual = info->var.xres;
+	var->yres = info->var.yres;
+	if (var->yres_virtual < var->yres)
+		var->yres_virtual = var->yres;
+	if (var->yres_virtual > info->var.yres * buffers)
+		var->yres_virtual = info->var.yres * buffers;
+	if (var->yoffset + var->yres > var->yres_virtual)
+		var->yoffset = 0;
+	var->xoffset = 0;
+
+	var->red = info->var.red;
+	var->green = info->var.green;
+	var->blue = info->var.blue;
+	var->transp = info->var.transp;
+	return 0;
+}
+
+/* 切换显示buffer, 下一次场同步生效 */
+static int myLCD_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
+{
+	return lcd_present_submit(&present, lcd_frame_addr(info, var->yoffset), true, NULL);
+}
+
+/* 与LCDIF驱动相同的私有ioctl */
+static int myLCD_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	struct mylcd_present req;
+	int ret;
+
+	if (cmd != MYLCDIO_PRESENT)
+		return lcd_present_ioctl(&present, cmd, argp);
+
+	if (copy_from_user(&req, argp, sizeof(req)))
+		return -EFAULT;
+	/* flags保留, 必须为0; 用减法比较yoffset, 避免u32回绕 */
+	if (req.flags || req.yoffset > info->var.yres_virtual - info->var.yres)
+		return -EINVAL;
+	ret = lcd_present_submit(&present, lcd_frame_addr(info, req.yoffset), false, &req.seqno);
+	if (ret)
+		return ret;
+	info->var.yoffset = req.yoffset;
+	return copy_to_user(argp, &req, sizeof(req)) ? -EFAULT : 0;
+}
+
+/* DMA内存交给DMA API映射; vmalloc的显存没有连续的物理地址, 需要自己映射 */
+static int myLCD_mmap(struct fb_info *info, struct vm_area_struct *vma)
+{
+	if (!fb_vmalloc)
+		return dma_mmap_wc(&myLCD_pdev->dev, vma, info->screen_base, fb_phys,
+				   info->fix.smem_len);
+	return remap_vmalloc_range(vma, info->screen_base, vma->vm_pgoff);
+}
+
 static struct fb_ops myLCD_ops = {
 	.owner		= THIS_MODULE,
+	.fb_check_var	= myLCD_check_var,
 	.fb_setcolreg	= myLCD_setcolreg,
-	.fb_fillrect	= cfb_fillrect,
-	.fb_copyarea	= cfb_copyarea,
-	.fb_imageblit	= cfb_imageblit,
+	.fb_pan_display	= myLCD_pan_display,
+	.fb_ioctl	= myLCD_ioctl,
+	.fb_mmap	= myLCD_mmap,
+	.fb_read	= fb_sys_read,
+	.fb_write	= fb_sys_write,
+	.fb_fillrect	= sys_fillrect,
+	.fb_copyarea	= sys_copyarea,
+	.fb_imageblit	= sys_imageblit,
 };
 
+/* 映射模拟的寄存器, 不存在时返回NULL */
+static struct lcd_regs *lcd_regs_map(void)
+{
+	struct lcd_regs *regs;
+
+	if (!regs_phys)
+		return NULL;
+	if (!request_mem_region(regs_phys, sizeof(struct lcd_regs), "myLCD"))
+		return NULL;
+	regs = ioremap(regs_phys, sizeof(struct lcd_regs));
+	if (!regs)
+		release_mem_region(regs_phys, sizeof(struct lcd_regs));
+	return regs;
+}
 
+static void lcd_regs_unmap(void)
+{
+	if (!myLCD_regs)
+		return;
+	iounmap(myLCD_regs);
+	release_mem_region(regs_phys, sizeof(struct lcd_regs));
+	myLCD_regs = NULL;
+}
 
 int __init myLCD_init(void)
 {
-	dma_addr_t phy_addr;
-
-	/* 分配fb_info结构体 */
-	fb_info = framebuffer_alloc(0, NULL);
-	/* 1.2 设置fb_info */
-	fb_info->var.xres = fb_info->var.xres_virtual = 500;//x方向分辨率
-	fb_info->var.yres = fb_info->var.yres_virtual = 300;//y方向分辨率
+	int ret;
 
-	fb_info->var.bits_per_pixel = 16;//RGB565
-	/* 红色位域 */
-	fb_info->var.red.offset = 11;
-	fb_info->var.red.length = 5;
-	/* 绿色位域 */
-	fb_info->var.green.offset = 5;
-	fb_info->var.green.length = 6;
-	/* 蓝色位域 */
-	fb_info->var.blue.offset = 0;
-	fb_info->var.blue.length = 5;
-
-	
+	if ((bpp != 16 && bpp != 32) || !xres || !yres || !buffers || !refresh) {
+		pr_err("myLCD: invalid parameters %ux%u %ubpp x%u @%uHz\n", xres, yres, bpp, buffers, refresh);
+		return -EINVAL;
+	}
 
+	myLCD_pdev = platform_device_register_simple("myLCD-virt", -1, NULL, 0);
+	if (IS_ERR(myLCD_pdev))
+		return PTR_ERR(myLCD_pdev);
+	ret = dma_coerce_mask_and_coherent(&myLCD_pdev->dev, DMA_BIT_MASK(32));
+	if (ret)
+		goto err_pdev;
 
-	strcpy(fb_info->fix.id, "my_lcd");
-	/* 计算显存范围 */
-	if(fb_info->var.bits_per_pixel == 16){//RGB565
-		fb_info->fix.smem_len = fb_info->var.xres * fb_info->var.yres * fb_info->var.bits_per_pixel / 8;
+	/* 分配fb_info结构体 */
+	fb_info = framebuffer_alloc(0, &myLCD_pdev->dev);
+	if (!fb_info) {
+		ret = -ENOMEM;
+		goto err_pdev;
 	}
-	else if(fb_info->var.bits_per_pixel == 24){//RGB888
-		fb_info->fix.smem_len = fb_info->var.xres * fb_info->var.yres * 4;
+	/* 1.2 设置fb_info */
+	fb_info->var.xres = fb_info->var.xres_virtual = xres;//x方向分辨率
+	fb_info->var.yres = yres;//y方向分辨率
+	fb_info->var.yres_virtual = yres * buffers;//虚拟屏幕包含所有画面, 可以直接pan/present
+
+	fb_info->var.bits_per_pixel = bpp;
+	if (bpp == 16) {//RGB565
+		fb_info->var.red.offset = 11;
+		fb_info->var.red.length = 5;
+		fb_info->var.green.offset = 5;
+		fb_info->var.green.length = 6;
+		fb_info->var.blue.offset = 0;
+		fb_info->var.blue.length = 5;
+	} else {//XRGB8888
+		fb_info->var.red.offset = 16;
+		fb_info->var.red.length = 8;
+		fb_info->var.green.offset = 8;
+		fb_info->var.green.length = 8;
+		fb_info->var.blue.offset = 0;
+		fb_info->var.blue.length = 8;
 	}
+	fb_info->var.activate = FB_ACTIVATE_NOW;
+	fb_info->var.vmode = FB_VMODE_NONINTERLACED;
 
-	/* fb的虚拟地址 */
-	fb_info->screen_base = dma_alloc_wc(NULL, fb_info->fix.smem_len, &phy_addr, GFP_KERNEL);
-	fb_info->fix.smem_start = phy_addr; /* fb的物理地址 */
+	strcpy(fb_info->fix.id, "my_lcd");
+	/* 计算显存范围 */
+	fb_info->fix.line_length = xres * bpp / 8;
+	fb_info->fix.smem_len = PAGE_ALIGN(fb_info->fix.line_length * yres * buffers);
 	fb_info->fix.type = FB_TYPE_PACKED_PIXELS;
 	fb_info->fix.visual = FB_VISUAL_TRUECOLOR;//真彩色
-	
-	if(fb_info->var.bits_per_pixel == 16){//RGB565
-		fb_info->fix.line_length = fb_info->var.xres * fb_info->var.bits_per_pixel / 8;
+	fb_info->fix.ypanstep = 1;
+
+	/* 1.4 硬件操作: 有寄存器时使用DMA内存, 否则退回普通内存 */
+	myLCD_regs = lcd_regs_map();
+	if (myLCD_regs) {
+		fb_info->screen_base = dma_alloc_wc(&myLCD_pdev->dev, fb_info->fix.smem_len, &fb_phys,
+						     GFP_KERNEL);
+		fb_info->fix.smem_start = fb_phys; /* fb的物理地址 */
+	} else {
+		pr_info("myLCD: no register window, using plain memory\n");
+		fb_info->screen_base = vmalloc_32_user(fb_info->fix.smem_len);
+		fb_info->flags |= FBINFO_VIRTFB;
+		fb_vmalloc = true;
 	}
-	else if(fb_info->var.bits_per_pixel == 24){//RGB888
-		fb_info->fix.line_length = fb_info->var.xres * 4;
+	if (!fb_info->screen_base) {
+		ret = -ENOMEM;
+		goto err_regs;
 	}
-	
+	fb_info->screen_size = fb_info->fix.smem_len;
+	fb_info->flags |= FBINFO_HWACCEL_YPAN;
+
 	fb_info->fbops = &myLCD_ops;
 	fb_info->pseudo_palette = pseudo_palette;
 
+	if (myLCD_regs) {
+		myLCD_regs->fb_base_phys = fb_phys;
+		myLCD_regs->fb_xres = xres;
+		myLCD_regs->fb_yres = yres;
+		myLCD_regs->fb_bpp = bpp;
+	}
+
+	/* 模拟场同步, 开始时扫描第一个画面 */
+	lcd_present_init(&present, lcd_next_buf_program);
+	next_buf = lcd_frame_addr(fb_info, 0);
+	vsync_period = ns_to_ktime(NSEC_PER_SEC / refresh);
+	hrtimer_init(&vsync_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	vsync_timer.function = lcd_vsync_timer_fn;
+	hrtimer_start(&vsync_timer, vsync_period, HRTIMER_MODE_REL);
+
 	/* 1.3 注册fb_info */
-	register_framebuffer(fb_info);
-	/* 1.4 硬件操作 */
-	myLCD_regs = ioremap(0x021c8000, sizeof(struct lcd_regs));
-	myLCD_regs->fb_base_phys = phy_addr;
-	myLCD_regs->fb_xres = 500;
-	myLCD_regs->fb_yres = 300;
-	myLCD_regs->fb_bpp = 16;
+	ret = register_framebuffer(fb_info);
+	if (ret)
+		goto err_timer;
+
+	pr_info("myLCD: %ux%u %ubpp, %u buffers, %uHz\n", xres, yres, bpp, buffers, refresh);
 	return 0;
+
+err_timer:
+	hrtimer_cancel(&vsync_timer);
+	if (fb_vmalloc)
+		vfree(fb_info->screen_base);
+	else
+		dma_free_wc(&myLCD_pdev->dev, fb_info->fix.smem_len, fb_info->screen_base, fb_phys);
+err_regs:
+	lcd_regs_unmap();
+	framebuffer_release(fb_info);
+err_pdev:
+	platform_device_unregister(myLCD_pdev);
+	return ret;
 }
 
 static void __exit myLCD_cleanup(void)
@@ -146,11 +357,20 @@ static void __exit myLCD_cleanup(void)
 	/* 反过来操作 */
 	/* 2.1 反注册fb_info */
 	unregister_framebuffer(fb_info);
-	
+
+	hrtimer_cancel(&vsync_timer);
+	lcd_present_release(&present);
+
+	if (fb_vmalloc)
+		vfree(fb_info->screen_base);
+	else
+		dma_free_wc(&myLCD_pdev->dev, fb_info->fix.smem_len, fb_info->screen_base, fb_phys);
+
 	/* 2.2 释放fb_info */
 	framebuffer_release(fb_info);
 
-	iounmap(myLCD_regs);
+	lcd_regs_unmap();
+	platform_device_unregister(myLCD_pdev);
 }
 
 
@@ -163,82 +383,3 @@ MODULE_AUTHOR("CHEN CHENG YANG");
 MODULE_AUTHOR("2594806402@qq.com");
 MODULE_DESCRIPTION("Framebuffer driver for the 7'RGBLCD");
 MODULE_LICENSE("GPL");
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,670 @@
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lcd_fb.h"
+
+/* 根据每像素位数得到像素格式 */
+static int lcd_bpp_to_format(unsigned int bpp, enum lcd_format *format)
+{
+	switch (bpp) {
+	case 8:
+		*format = LCD_FMT_C8;
+		return 0;
+	case 16:
+		*format = LCD_FMT_RGB565;
+		return 0;
+	case 32:
+		*format = LCD_FMT_XRGB8888;
+		return 0;
+	default:
+		printf("can't surport %dbpp\n", bpp);
+		return -1;
+	}
+}
+
+/**********************************************************************
+ * 函数名称： lcd_surface_init
+ * 功能描述： 用一块已有内存初始化surface
+ * 输入参数： 内存地址，宽，高，每行字节数(0表示紧密排列)，每像素位数
+ * 输出参数： surface
+ * 返 回 值： 0-成功，-1-不支持的bpp
+ ***********************************************************************/
+int lcd_surface_init(struct lcd_surface *s, void *base, unsigned int width,
+		     unsigned int height, unsigned int stride, unsigned int bpp)
+{
+	if (lcd_bpp_to_format(bpp, &s->format))
+		return -1;
+	s->base = base;
+	s->width = width;
+	s->height = height;
+	s->pixel_width = bpp / 8;
+	s->stride = stride ? stride : width * s->pixel_width;
+	return 0;
+}
+
+/* 按display的参数把映射好的内存切分成nbuffers个surface */
+static int lcd_display_setup_buffers(struct lcd_display *disp, unsigned int nbuffers)
+{
+	unsigned int i;
+	size_t screen_size = (size_t)disp->fix.line_length * disp->var.yres;
+
+	if (nbuffers == 0 || nbuffers > LCD_MAX_BUFFERS)
+		return -1;
+	for (i = 0; i < nbuffers; i++) {
+		if (lcd_surface_init(&disp->buffers[i], (unsigned char *)disp->map_base + i * screen_size,
+				     disp->var.xres, disp->var.yres, disp->fix.line_length,
+				     disp->var.bits_per_pixel))
+			return -1;
+	}
+	disp->nbuffers = nbuffers;
+	disp->front = 0;
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_open
+ * 功能描述： 打开framebuffer设备，映射全部显存并按需设置多buffer
+ * 输入参数： 设备名(如"/dev/fb0")，buffer个数(0表示显存能容纳的最多个数)
+ * 输出参数： 无
+ * 返 回 值： display句柄，失败返回NULL
+ ***********************************************************************/
+struct lcd_display *lcd_display_open(const char *dev, unsigned int nbuffers)
+{
+	struct lcd_display *disp;
+	unsigned int max_buffers;
+	size_t screen_size;
+
+	disp = calloc(1, sizeof(*disp));
+	if (!disp)
+		return NULL;
+	disp->backend = LCD_BACKEND_FB;
+	disp->event_fd = -1;
+
+	/* 打开 framebuffer 设备 */
+	disp->fd = open(dev, O_RDWR);
+	if (disp->fd < 0) {
+		printf("can't open %s\n", dev);
+		goto err_free;
+	}
+	/* 获取屏幕参数 */
+	if (ioctl(disp->fd, FBIOGET_FSCREENINFO, &disp->fix)) {
+		printf("can't get fix\n");
+		goto err_close;
+	}
+	if (ioctl(disp->fd, FBIOGET_VSCREENINFO, &disp->var)) {
+		printf("can't get var\n");
+		goto err_close;
+	}
+	/*
+	 * 驱动是否支持异步显示只在这里判断一次, 之后所有路径都按这个标志处理:
+	 * 其他驱动对不认识的命令可能返回ENOTTY也可能返回EINVAL, 不能在每次调用时按errno猜
+	 */
+	disp->present_emulated = ioctl(disp->fd, MYLCDIO_GET_STATUS, &disp->status) != 0;
+
+	/* 计算显存能容纳多少个buffer */
+	screen_size = (size_t)disp->fix.line_length * disp->var.yres;
+	max_buffers = disp->fix.smem_len / screen_size;
+	if (max_buffers > LCD_MAX_BUFFERS)
+		max_buffers = LCD_MAX_BUFFERS;
+	if (nbuffers == 0 || nbuffers > max_buffers)
+		nbuffers = max_buffers;
+
+	/* 虚拟y分辨率为多个buffer的空间, 驱动不支持时退回单buffer */
+	if (nbuffers > 1 && disp->var.yres_virtual != nbuffers * disp->var.yres) {
+		disp->var.yres_virtual = nbuffers * disp->var.yres;
+		if (ioctl(disp->fd, FBIOPUT_VSCREENINFO, &disp->var))
+			nbuffers = 1;
+		ioctl(disp->fd, FBIOGET_VSCREENINFO, &disp->var);
+		ioctl(disp->fd, FBIOGET_FSCREENINFO, &disp->fix);
+		if (disp->var.yres_virtual < nbuffers * disp->var.yres)
+			nbuffers = disp->var.yres_virtual / disp->var.yres;
+	}
+
+	/* 映射全部显存 */
+	disp->map_len = disp->fix.smem_len;
+	disp->map_base = mmap(NULL, disp->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, disp->fd, 0);
+	if (disp->map_base == MAP_FAILED) {
+		printf("can't mmap\n");
+		goto err_close;
+	}
+
+	if (lcd_display_setup_buffers(disp, nbuffers ? nbuffers : 1))
+		goto err_unmap;
+	disp->front = disp->var.yoffset / disp->var.yres;
+	if (disp->front >= disp->nbuffers)
+		disp->front = 0;
+	return disp;
+
+err_unmap:
+	munmap(disp->map_base, disp->map_len);
+err_close:
+	close(disp->fd);
+err_free:
+	free(disp);
+	return NULL;
+}
+
+/* 为内存/文件后端伪造fb参数, 使所有后端走同样的路径 */
+static int lcd_display_fake_info(struct lcd_display *disp, unsigned int width,
+				 unsigned int height, unsigned int bpp, unsigned int nbuffers)
+{
+	enum lcd_format format;
+
+	if (lcd_bpp_to_format(bpp, &format) || nbuffers == 0 || nbuffers > LCD_MAX_BUFFERS)
+		return -1;
+
+	disp->var.xres = disp->var.xres_virtual = width;
+	disp->var.yres = height;
+	disp->var.yres_virtual = height * nbuffers;
+	disp->var.bits_per_pixel = bpp;
+	disp->fix.line_length = width * bpp / 8;
+	disp->fix.smem_len = disp->fix.line_length * disp->var.yres_virtual;
+	disp->map_len = disp->fix.smem_len;
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_open_mem
+ * 功能描述： 创建一个匿名内存后端的display，用于无屏环境下的测试
+ * 输入参数： 宽，高，每像素位数，buffer个数
+ * 输出参数： 无
+ * 返 回 值： display句柄，失败返回NULL
+ ***********************************************************************/
+struct lcd_display *lcd_display_open_mem(unsigned int width, unsigned int height,
+					 unsigned int bpp, unsigned int nbuffers)
+{
+	struct lcd_display *disp;
+
+	disp = calloc(1, sizeof(*disp));
+	if (!disp)
+		return NULL;
+	disp->backend = LCD_BACKEND_MEM;
+	disp->fd = -1;
+	disp->event_fd = -1;
+	disp->present_emulated = 1;
+
+	if (lcd_display_fake_info(disp, width, height, bpp, nbuffers))
+		goto err_free;
+	disp->map_base = mmap(NULL, disp->map_len, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (disp->map_base == MAP_FAILED) {
+		printf("can't mmap anonymous memory\n");
+		goto err_free;
+	}
+	if (lcd_display_setup_buffers(disp, nbuffers))
+		goto err_unmap;
+	return disp;
+
+err_unmap:
+	munmap(disp->map_base, disp->map_len);
+err_free:
+	free(disp);
+	return NULL;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_open_file
+ * 功能描述： 创建一个文件后端的display，画面内容保存在文件中
+ * 输入参数： 文件路径，宽，高，每像素位数，buffer个数
+ * 输出参数： 无
+ * 返 回 值： display句柄，失败返回NULL
+ ***********************************************************************/
+struct lcd_display *lcd_display_open_file(const char *path, unsigned int width,
+					  unsigned int height, unsigned int bpp,
+					  unsigned int nbuffers)
+{
+	struct lcd_display *disp;
+
+	disp = calloc(1, sizeof(*disp));
+	if (!disp)
+		return NULL;
+	disp->backend = LCD_BACKEND_FILE;
+	disp->event_fd = -1;
+	disp->present_emulated = 1;
+
+	if (lcd_display_fake_info(disp, width, height, bpp, nbuffers))
+		goto err_free;
+	disp->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (disp->fd < 0) {
+		printf("can't open %s\n", path);
+		goto err_free;
+	}
+	if (ftruncate(disp->fd, disp->map_len)) {
+		printf("can't resize %s\n", path);
+		goto err_close;
+	}
+	disp->map_base = mmap(NULL, disp->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, disp->fd, 0);
+	if (disp->map_base == MAP_FAILED) {
+		printf("can't mmap %s\n", path);
+		goto err_close;
+	}
+	if (lcd_display_setup_buffers(disp, nbuffers))
+		goto err_unmap;
+	return disp;
+
+err_unmap:
+	munmap(disp->map_base, disp->map_len);
+err_close:
+	close(disp->fd);
+err_free:
+	free(disp);
+	return NULL;
+}
+
+void lcd_display_close(struct lcd_display *disp)
+{
+	if (!disp)
+		return;
+	if (disp->event_fd >= 0) {
+		if (!disp->present_emulated) {
+			int fd = -1;
+
+			ioctl(disp->fd, MYLCDIO_SET_EVENTFD, &fd);
+		}
+		close(disp->event_fd);
+	}
+	munmap(disp->map_base, disp->map_len);
+	if (disp->fd >= 0)
+		close(disp->fd);
+	free(disp);
+}
+
+struct lcd_surface *lcd_display_buffer(struct lcd_display *disp, unsigned int index)
+{
+	if (index >= disp->nbuffers)
+		return NULL;
+	return &disp->buffers[index];
+}
+
+unsigned int lcd_display_back_index(struct lcd_display *disp)
+{
+	return (disp->front + 1) % disp->nbuffers;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_set_rotate
+ * 功能描述： 设置画面旋转角度，旋转后宽高和行跨度可能变化，buffer重新切分
+ * 输入参数： display，FB_ROTATE_UR/CW/UD/CCW
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-失败
+ * 注     意:  只有fb后端支持
+ ***********************************************************************/
+int lcd_display_set_rotate(struct lcd_display *disp, unsigned int rotate)
+{
+	struct fb_var_screeninfo var = disp->var;
+	unsigned int nbuffers = disp->nbuffers;
+
+	if (disp->backend != LCD_BACKEND_FB)
+		return -1;
+
+	var.rotate = rotate;
+	var.yoffset = 0;
+	/* 驱动会按旋转后的分辨率调整xres/yres, 并把yres_virtual限制在显存范围内 */
+	var.yres_virtual = nbuffers * (var.xres > var.yres ? var.xres : var.yres);
+	if (ioctl(disp->fd, FBIOPUT_VSCREENINFO, &var)) {
+		printf("can't set rotate %u\n", rotate);
+		return -1;
+	}
+	ioctl(disp->fd, FBIOGET_VSCREENINFO, &disp->var);
+	ioctl(disp->fd, FBIOGET_FSCREENINFO, &disp->fix);
+
+	nbuffers = disp->var.yres_virtual / disp->var.yres;
+	if (nbuffers > LCD_MAX_BUFFERS)
+		nbuffers = LCD_MAX_BUFFERS;
+	return lcd_display_setup_buffers(disp, nbuffers);
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_set_bpp
+ * 功能描述： 切换像素格式，8为256色调色板，16为RGB565
+ * 输入参数： display，每像素位数
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-失败
+ * 注     意:  只有fb后端支持; 8bpp时显存可以容纳两倍的buffer
+ ***********************************************************************/
+int lcd_display_set_bpp(struct lcd_display *disp, unsigned int bpp)
+{
+	struct fb_var_screeninfo var = disp->var;
+	enum lcd_format format;
+	unsigned int nbuffers;
+
+	if (disp->backend != LCD_BACKEND_FB || lcd_bpp_to_format(bpp, &format))
+		return -1;
+
+	var.bits_per_pixel = bpp;
+	var.yoffset = 0;
+	/* 驱动会把yres_virtual限制在显存范围内 */
+	var.yres_virtual = var.yres * LCD_MAX_BUFFERS;
+	if (ioctl(disp->fd, FBIOPUT_VSCREENINFO, &var)) {
+		printf("can't set %ubpp\n", bpp);
+		return -1;
+	}
+	ioctl(disp->fd, FBIOGET_VSCREENINFO, &disp->var);
+	ioctl(disp->fd, FBIOGET_FSCREENINFO, &disp->fix);
+
+	nbuffers = disp->var.yres_virtual / disp->var.yres;
+	if (nbuffers > LCD_MAX_BUFFERS)
+		nbuffers = LCD_MAX_BUFFERS;
+	disp->front = 0;
+	return lcd_display_setup_buffers(disp, nbuffers);
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_set_palette
+ * 功能描述： 设置8bpp调色板的第start项开始的count项(FBIOPUTCMAP)
+ * 输入参数： display，起始序号，个数，颜色数组(0x00RRGGBB)
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-失败
+ ***********************************************************************/
+int lcd_display_set_palette(struct lcd_display *disp, unsigned int start,
+			    unsigned int count, const unsigned int *rgb)
+{
+	uint16_t red[256], green[256], blue[256];
+	struct fb_cmap cmap;
+	unsigned int i;
+
+	if (start + count > 256)
+		return -1;
+	if (disp->backend != LCD_BACKEND_FB)
+		return 0;
+
+	/* fb_cmap的每个分量是16位 */
+	for (i = 0; i < count; i++) {
+		red[i]   = ((rgb[i] >> 16) & 0xff) * 0x101;
+		green[i] = ((rgb[i] >> 8) & 0xff) * 0x101;
+		blue[i]  = (rgb[i] & 0xff) * 0x101;
+	}
+	memset(&cmap, 0, sizeof(cmap));
+	cmap.start = start;
+	cmap.len = count;
+	cmap.red = red;
+	cmap.green = green;
+	cmap.blue = blue;
+	if (ioctl(disp->fd, FBIOPUTCMAP, &cmap)) {
+		printf("can't set palette\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_flip
+ * 功能描述： 切换到第index个buffer显示
+ * 输入参数： display，buffer序号
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-失败
+ * 注     意:  内存/文件后端只记录当前buffer
+ ***********************************************************************/
+int lcd_display_flip(struct lcd_display *disp, unsigned int index)
+{
+	if (index >= disp->nbuffers)
+		return -1;
+
+	/* 设置buffer偏移大小, 把偏移后的buffer地址写入寄存器 */
+	if (lcd_display_pan(disp, index * disp->var.yres))
+		return -1;
+	disp->front = index;
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_pan
+ * 功能描述： 把显示窗口移动到虚拟屏幕的第yoffset行
+ * 输入参数： display，y偏移
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-失败
+ * 注     意:  内存/文件后端只记录偏移
+ ***********************************************************************/
+int lcd_display_pan(struct lcd_display *disp, unsigned int yoffset)
+{
+	if (yoffset + disp->var.yres > disp->var.yres_virtual)
+		return -1;
+
+	disp->var.yoffset = yoffset;
+	if (disp->backend == LCD_BACKEND_FB && ioctl(disp->fd, FBIOPAN_DISPLAY, &disp->var))
+		return -1;
+	return 0;
+}
+
+/* 0x00RRGGBB 转换为surface的像素值 */
+unsigned int lcd_color_pack(enum lcd_format format, unsigned int rgb)
+{
+	unsigned int red, green, blue;
+
+	switch (format) {
+	case LCD_FMT_RGB565:
+		red   = (rgb >> 16) & 0xff;
+		green = (rgb >> 8) & 0xff;
+		blue  = (rgb >> 0) & 0xff;
+		return ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3);
+	case LCD_FMT_XRGB8888:
+		return rgb & 0x00ffffff;
+	case LCD_FMT_C8:
+	default:
+		return rgb & 0xff;
+	}
+}
+
+void lcd_surface_put_pixel(struct lcd_surface *s, int x, int y, unsigned int rgb)
+{
+	unsigned char *pen_8;
+
+	if ((unsigned int)x >= s->width || (unsigned int)y >= s->height)
+		return;
+
+	pen_8 = (unsigned char *)lcd_surface_row(s, y) + x * s->pixel_width;
+	switch (s->format) {
+	case LCD_FMT_C8:
+		*pen_8 = rgb;
+		break;
+	case LCD_FMT_RGB565:
+		*(uint16_t *)pen_8 = lcd_color_pack(s->format, rgb);
+		break;
+	case LCD_FMT_XRGB8888:
+		*(uint32_t *)pen_8 = rgb;
+		break;
+	}
+}
+
+/*
+ * 行填充函数, 每种像素格式一个, 所有填充操作的热点循环
+ * 调用前已经裁剪, len > 0; 对显存按行顺序写，利于写合并
+ */
+static void span_c8(const struct lcd_surface *s, int x, int y, int len, unsigned int pixel)
+{
+	memset((unsigned char *)lcd_surface_row(s, y) + x, pixel, len);
+}
+
+static void span_rgb565(const struct lcd_surface *s, int x, int y, int len, unsigned int pixel)
+{
+	uint16_t *pen_16 = (uint16_t *)lcd_surface_row(s, y) + x;
+	uint32_t *pen_32;
+	uint32_t pair = (pixel & 0xffff) | (pixel << 16);
+
+	/* 先对齐到4字节，再每次写两个像素 */
+	if ((uintptr_t)pen_16 & 2) {
+		*pen_16++ = pixel;
+		len--;
+	}
+	pen_32 = (uint32_t *)pen_16;
+	for (; len >= 2; len -= 2)
+		*pen_32++ = pair;
+	if (len)
+		*(uint16_t *)pen_32 = pixel;
+}
+
+static void span_xrgb8888(const struct lcd_surface *s, int x, int y, int len, unsigned int pixel)
+{
+	uint32_t *pen_32 = (uint32_t *)lcd_surface_row(s, y) + x;
+
+	while (len--)
+		*pen_32++ = pixel;
+}
+
+/* 按像素格式选择行填充函数, 调用者在循环外选好, 热点循环中不再判断格式 */
+lcd_span_fn lcd_surface_span_fn(enum lcd_format format)
+{
+	switch (format) {
+	case LCD_FMT_C8:
+		return span_c8;
+	case LCD_FMT_RGB565:
+		return span_rgb565;
+	case LCD_FMT_XRGB8888:
+	default:
+		return span_xrgb8888;
+	}
+}
+
+/**********************************************************************
+ * 函数名称： lcd_surface_fill_span
+ * 功能描述： 用已打包的像素值填充一行中的一段
+ * 输入参数： surface，起点x，y，长度，像素值(lcd_color_pack的结果)
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 注     意:  超出surface的部分被裁剪, 再交给lcd_surface_span_fn选出的行填充函数
+ ***********************************************************************/
+void lcd_surface_fill_span(struct lcd_surface *s, int x, int y, int len, unsigned int pixel)
+{
+	if ((unsigned int)y >= s->height)
+		return;
+	if (x < 0) {
+		len += x;
+		x = 0;
+	}
+	if (x + len > (int)s->width)
+		len = s->width - x;
+	if (len <= 0)
+		return;
+
+	lcd_surface_span_fn(s->format)(s, x, y, len, pixel);
+}
+
+void lcd_surface_fill_rect(struct lcd_surface *s, int x, int y, int w, int h, unsigned int rgb)
+{
+	unsigned int pixel = lcd_color_pack(s->format, rgb);
+	int j;
+
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	if (y + h > (int)s->height)
+		h = s->height - y;
+	for (j = 0; j < h; j++)
+		lcd_surface_fill_span(s, x, y + j, w, pixel);
+}
+
+void lcd_surface_fill(struct lcd_surface *s, unsigned int rgb)
+{
+	lcd_surface_fill_rect(s, 0, 0, s->width, s->height, rgb);
+}
+
+/* 用户态模拟一次提交: 立即显示, 上一帧立即释放 */
+static void lcd_display_present_emulate(struct lcd_display *disp, unsigned int index)
+{
+	uint64_t one = 1;
+
+	disp->status.submitted++;
+	disp->status.released = disp->status.displayed;
+	disp->status.displayed = disp->status.submitted;
+	disp->buf_seqno[index] = disp->status.submitted;
+	disp->front = index;
+	if (disp->event_fd >= 0 && write(disp->event_fd, &one, sizeof(one)) < 0)
+		perror("eventfd write");
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_present
+ * 功能描述： 异步提交第index个buffer显示，不等待场同步
+ * 输入参数： display，buffer序号
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-失败(errno为EBUSY表示驱动队列已满, EINVAL表示参数错误)
+ * 注     意:  打开时探测到驱动不支持时, 使用FBIOPAN_DISPLAY并在用户态模拟fence
+ ***********************************************************************/
+int lcd_display_present(struct lcd_display *disp, unsigned int index)
+{
+	struct mylcd_present req;
+
+	if (index >= disp->nbuffers)
+		return -1;
+
+	if (!disp->present_emulated) {
+		memset(&req, 0, sizeof(req));
+		req.yoffset = index * disp->var.yres;
+		if (ioctl(disp->fd, MYLCDIO_PRESENT, &req))
+			return -1;
+		disp->buf_seqno[index] = req.seqno;
+		disp->status.submitted = req.seqno;
+		return 0;
+	}
+
+	if (lcd_display_flip(disp, index))
+		return -1;
+	lcd_display_present_emulate(disp, index);
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_display_event_fd
+ * 功能描述： 取得用于poll的eventfd，帧开始显示/释放时可读
+ * 输入参数： display
+ * 输出参数： 无
+ * 返 回 值： 文件描述符，失败返回-1
+ ***********************************************************************/
+int lcd_display_event_fd(struct lcd_display *disp)
+{
+	if (disp->event_fd >= 0)
+		return disp->event_fd;
+
+	disp->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (disp->event_fd < 0)
+		return -1;
+	if (!disp->present_emulated &&
+	    ioctl(disp->fd, MYLCDIO_SET_EVENTFD, &disp->event_fd)) {
+		close(disp->event_fd);
+		disp->event_fd = -1;
+	}
+	return disp->event_fd;
+}
+
+/* eventfd可读后调用: 清除事件并读取最新的fence状态 */
+int lcd_display_dispatch(struct lcd_display *disp)
+{
+	uint64_t cnt;
+	unsigned int i;
+
+	if (disp->event_fd >= 0 && read(disp->event_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+		return -1;
+	if (!disp->present_emulated &&
+	    ioctl(disp->fd, MYLCDIO_GET_STATUS, &disp->status))
+		return -1;
+
+	/* 序号等于displayed的buffer正在显示 */
+	for (i = 0; i < disp->nbuffers; i++)
+		if (disp->buf_seqno[i] && disp->buf_seqno[i] == disp->status.displayed)
+			disp->front = i;
+	return 0;
+}
+
+int lcd_display_acquire(struct lcd_display *disp)
+{
+	unsigned int i, index;
+
+	/* 从当前显示的下一个开始找, 保证轮流使用 */
+	for (i = 1; i <= disp->nbuffers; i++) {
+		index = (disp->front + i) % disp->nbuffers;
+		if (index != disp->front && disp->buf_seqno[index] <= disp->status.displayed)
+			return index;
+	}
+	return -1;
+}
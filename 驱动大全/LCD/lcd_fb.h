@@ -0,0 +1,113 @@
+#ifndef _LCD_FB_H
+#define _LCD_FB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/fb.h>
+
+#include "lcd_ioctl.h"
+
+/*
+ * 用户态framebuffer访问库
+ * display: 一个显示设备(/dev/fbN、匿名内存或文件), 包含若干个显示buffer
+ * surface: 一块可绘制的内存, 自带宽高/行跨度/像素格式, 绘制函数只依赖surface
+ * 编译: arm-buildroot-linux-gnueabihf-gcc -O2 -o app app.c lcd_fb.c
+ */
+
+#define LCD_MAX_BUFFERS	4
+
+/* 像素格式 */
+enum lcd_format {
+	LCD_FMT_C8 = 0,		/* 8bpp 调色板索引 */
+	LCD_FMT_RGB565,		/* 16bpp */
+	LCD_FMT_XRGB8888,	/* 32bpp */
+};
+
+/* display 的后端类型 */
+enum lcd_backend {
+	LCD_BACKEND_FB = 0,	/* /dev/fbN */
+	LCD_BACKEND_MEM,	/* 匿名内存, 用于无屏测试 */
+	LCD_BACKEND_FILE,	/* 文件映射, 可事后查看画面 */
+};
+
+struct lcd_surface {
+	void *base;			/* 左上角像素地址 */
+	unsigned int width;		/* 像素 */
+	unsigned int height;		/* 像素 */
+	unsigned int stride;		/* 每行字节数 */
+	unsigned int pixel_width;	/* 每像素字节数 */
+	enum lcd_format format;
+};
+
+struct lcd_display {
+	enum lcd_backend backend;
+	int fd;				/* fb或文件的描述符, 匿名内存为-1 */
+	struct fb_var_screeninfo var;
+	struct fb_fix_screeninfo fix;
+	void *map_base;			/* mmap得到的地址 */
+	size_t map_len;			/* mmap的长度, munmap时使用 */
+	unsigned int nbuffers;		/* 显示buffer个数 */
+	unsigned int front;		/* 当前正在显示的buffer */
+	struct lcd_surface buffers[LCD_MAX_BUFFERS];
+	/* 异步显示 */
+	int event_fd;			/* eventfd, 未创建时为-1 */
+	int present_emulated;		/* 驱动不支持异步显示时在用户态模拟 */
+	uint64_t buf_seqno[LCD_MAX_BUFFERS];	/* 每个buffer最后一次提交的序号 */
+	struct mylcd_present_status status;
+};
+
+/* 打开显示设备, nbuffers为0时使用显存能容纳的最多buffer */
+struct lcd_display *lcd_display_open(const char *dev, unsigned int nbuffers);
+struct lcd_display *lcd_display_open_mem(unsigned int width, unsigned int height,
+					 unsigned int bpp, unsigned int nbuffers);
+struct lcd_display *lcd_display_open_file(const char *path, unsigned int width,
+					  unsigned int height, unsigned int bpp,
+					  unsigned int nbuffers);
+void lcd_display_close(struct lcd_display *disp);
+
+/* 第index个显示buffer */
+struct lcd_surface *lcd_display_buffer(struct lcd_display *disp, unsigned int index);
+/* 下一个可绘制的后台buffer */
+unsigned int lcd_display_back_index(struct lcd_display *disp);
+/* 设置旋转角度(FB_ROTATE_UR/CW/UD/CCW), 由驱动在flip时旋转到面板方向 */
+int lcd_display_set_rotate(struct lcd_display *disp, unsigned int rotate);
+/* 切换像素格式: 8(256色调色板, 扫描带宽是RGB565的一半) 或 16(RGB565) */
+int lcd_display_set_bpp(struct lcd_display *disp, unsigned int bpp);
+/* 设置8bpp调色板, rgb为0x00RRGGBB */
+int lcd_display_set_palette(struct lcd_display *disp, unsigned int start,
+			    unsigned int count, const unsigned int *rgb);
+/* 把显示窗口平移到虚拟屏幕的第yoffset行(FBIOPAN_DISPLAY), 用于滚屏 */
+int lcd_display_pan(struct lcd_display *disp, unsigned int yoffset);
+/* 切换显示第index个buffer(FBIOPAN_DISPLAY), 返回0表示成功 */
+int lcd_display_flip(struct lcd_display *disp, unsigned int index);
+
+/*
+ * 异步显示: present只排队不阻塞, 用poll等待lcd_display_event_fd()可读后
+ * 调用lcd_display_dispatch()更新状态, 再用lcd_display_acquire()取得空闲buffer
+ */
+int lcd_display_present(struct lcd_display *disp, unsigned int index);
+int lcd_display_event_fd(struct lcd_display *disp);
+int lcd_display_dispatch(struct lcd_display *disp);
+/* 返回一个不在显示也不在排队的buffer, 没有时返回-1 */
+int lcd_display_acquire(struct lcd_display *disp);
+
+/* surface 操作 */
+int lcd_surface_init(struct lcd_surface *s, void *base, unsigned int width,
+		     unsigned int height, unsigned int stride, unsigned int bpp);
+unsigned int lcd_color_pack(enum lcd_format format, unsigned int rgb);
+void lcd_surface_put_pixel(struct lcd_surface *s, int x, int y, unsigned int rgb);
+void lcd_surface_fill_span(struct lcd_surface *s, int x, int y, int len, unsigned int pixel);
+/* 把一段span [x, x+len) 写入第y行, 调用者保证已经裁剪且len > 0 */
+typedef void (*lcd_span_fn)(const struct lcd_surface *s, int x, int y, int len,
+			    unsigned int pixel);
+/* 按像素格式选择行填充函数, lcd_surface_fill_span和光栅化共用 */
+lcd_span_fn lcd_surface_span_fn(enum lcd_format format);
+void lcd_surface_fill_rect(struct lcd_surface *s, int x, int y, int w, int h, unsigned int rgb);
+void lcd_surface_fill(struct lcd_surface *s, unsigned int rgb);
+
+static inline void *lcd_surface_row(const struct lcd_surface *s, int y)
+{
+	return (unsigned char *)s->base + (size_t)y * s->stride;
+}
+
+#endif /* _LCD_FB_H */
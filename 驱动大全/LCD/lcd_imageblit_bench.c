@@ -0,0 +1,236 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcd_fb.h"
+#include "lcd_blit_expand.h"
+
+/**********************************************************************
+ * 文件说明： 驱动中查表展开的imageblit与通用cfb_imageblit的对比
+ * 			  在内存surface上按fbcon的方式输出8x16字符行，比较结果和速度
+ * 			  cfb一栏与内核的选择相同: 对齐时用移植来的fast_imageblit,
+ * 			  否则(16bpp奇数dx)用逐bit的slow路径
+ * 用     法:  ./lcd_imageblit_bench [次数]
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -o lcd_imageblit_bench \
+ * 				lcd_imageblit_bench.c lcd_fb.c
+ ***********************************************************************/
+
+#define FONT_W		8
+#define FONT_H		16
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* 以下移植自内核 drivers/video/fbdev/core/cfbimgblt.c (小端) */
+static const uint32_t cfb_tab16_le[] = {
+	0x00000000, 0xffff0000, 0x0000ffff, 0xffffffff
+};
+
+static const uint32_t cfb_tab32[] = {
+	0x00000000, 0xffffffff
+};
+
+/* fast_imageblit: dst 32位对齐且宽度是每字像素数的整数倍时, 每次查表得到一个32位字 */
+static void fast_imageblit(struct lcd_surface *s, uint8_t *dst1, const uint8_t *data,
+			   unsigned int width, unsigned int height, uint32_t fgcolor, uint32_t bgcolor)
+{
+	uint32_t fgx = fgcolor, bgx = bgcolor, bpp = s->pixel_width * 8;
+	uint32_t ppw = 32 / bpp, spitch = (width + 7) / 8;
+	uint32_t bit_mask, end_mask, eorx, shift;
+	const uint8_t *src;
+	uint32_t *dst;
+	const uint32_t *tab = (bpp == 16) ? cfb_tab16_le : cfb_tab32;
+	int i, j, k;
+
+	for (i = ppw - 1; i--; ) {
+		fgx <<= bpp;
+		bgx <<= bpp;
+		fgx |= fgcolor;
+		bgx |= bgcolor;
+	}
+
+	bit_mask = (1 << ppw) - 1;
+	eorx = fgx ^ bgx;
+	k = width / ppw;
+
+	for (i = height; i--; ) {
+		dst = (uint32_t *)dst1;
+		shift = 8;
+		src = data;
+
+		for (j = k; j--; ) {
+			shift -= ppw;
+			end_mask = tab[(*src >> shift) & bit_mask];
+			*dst++ = (end_mask & eorx) ^ bgx;
+			if (!shift) {
+				shift = 8;
+				src++;
+			}
+		}
+		dst1 += s->stride;
+		data += spitch;
+	}
+}
+
+/*
+ * 不满足fast条件时内核用slow_imageblit逐bit拼字, 这里是它的简化版:
+ * 只处理小端, 不对齐的首尾字用memcpy写而不是读-改-写
+ */
+static void slow_imageblit(struct lcd_surface *s, uint8_t *dst, const uint8_t *src,
+			   unsigned int width, unsigned int height, uint32_t fg, uint32_t bg)
+{
+	unsigned int bpp = s->pixel_width * 8;
+	unsigned int spitch = (width + 7) / 8;
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++) {
+		uint8_t *d = dst + y * s->stride;
+		const uint8_t *b = src + y * spitch;
+		uint32_t val = 0, shift = 0;
+
+		for (x = 0; x < width; x++) {
+			uint32_t color = (b[x >> 3] & (0x80 >> (x & 7))) ? fg : bg;
+
+			val |= color << shift;
+			shift += bpp;
+			if (shift == 32) {
+				memcpy(d, &val, 4);
+				d += 4;
+				val = 0;
+				shift = 0;
+			}
+		}
+		if (shift)
+			memcpy(d, &val, shift / 8);
+	}
+}
+
+/* 与cfb_imageblit相同的路径选择 */
+static void cfb_imageblit_ref(struct lcd_surface *s, int dx, int dy, const uint8_t *src,
+			      unsigned int width, unsigned int height, uint32_t fg, uint32_t bg)
+{
+	uint8_t *dst = (uint8_t *)lcd_surface_row(s, dy) + dx * s->pixel_width;
+	unsigned int ppw = 4 / s->pixel_width;
+
+	if (!((uintptr_t)dst & 3) && !(s->stride & 3) && !(width & (ppw - 1)))
+		fast_imageblit(s, dst, src, width, height, fg, bg);
+	else
+		slow_imageblit(s, dst, src, width, height, fg, bg);
+}
+
+static int surface_equal(const struct lcd_surface *a, const struct lcd_surface *b)
+{
+	unsigned int y;
+
+	for (y = 0; y < a->height; y++)
+		if (memcmp(lcd_surface_row(a, y), lcd_surface_row(b, y), a->width * a->pixel_width))
+			return 0;
+	return 1;
+}
+
+/* 输出一整屏字符: 每行一个(xres/8)个字符宽的位图, 与fbcon的putcs相同; dx为屏幕左边距 */
+static void draw_screen(struct lcd_surface *s, int dx, const uint8_t *line_img, int use_table,
+			struct lcd_expand_table *tab, uint32_t fg, uint32_t bg)
+{
+	unsigned int width = (s->width - dx) / FONT_W * FONT_W;
+	unsigned int row;
+
+	for (row = 0; row + FONT_H <= s->height; row += FONT_H) {
+		if (use_table) {
+			lcd_expand_table_update(tab, fg, bg, s->pixel_width * 8);
+			lcd_expand_mono(tab, (uint8_t *)lcd_surface_row(s, row) + dx * s->pixel_width,
+					s->stride, line_img, width / 8, width, FONT_H);
+		} else {
+			cfb_imageblit_ref(s, dx, row, line_img, width, FONT_H, fg, bg);
+		}
+	}
+}
+
+/* 两种方式各输出loops屏, 比较结果; 返回0表示一致 */
+static int bench_one(unsigned int bpp, int dx, const uint8_t *line_img,
+		     const uint8_t *odd_img, int loops)
+{
+	struct lcd_display *ref = lcd_display_open_mem(1024, 600, bpp, 1);
+	struct lcd_display *out = lcd_display_open_mem(1024, 600, bpp, 1);
+	enum lcd_format fmt = (bpp == 16) ? LCD_FMT_RGB565 : LCD_FMT_XRGB8888;
+	uint32_t fg = lcd_color_pack(fmt, 0xaaaaaa);
+	uint32_t bg = lcd_color_pack(fmt, 0x000020);
+	struct lcd_expand_table tab;
+	struct lcd_surface *rs, *os;
+	double t0, t_cfb, t_lut;
+	int n, ok;
+
+	if (!ref || !out)
+		return -1;
+	rs = lcd_display_buffer(ref, 0);
+	os = lcd_display_buffer(out, 0);
+	memset(&tab, 0, sizeof(tab));
+
+	t0 = now_ms();
+	for (n = 0; n < loops; n++)
+		draw_screen(rs, dx, line_img, 0, &tab, fg, bg);
+	t_cfb = (now_ms() - t0) / loops;
+
+	t0 = now_ms();
+	for (n = 0; n < loops; n++)
+		draw_screen(os, dx, line_img, 1, &tab, fg, bg);
+	t_lut = (now_ms() - t0) / loops;
+
+	/* 不足8像素宽、奇数和偶数dx的位置 */
+	cfb_imageblit_ref(rs, 3, 5, odd_img, 21, 11, bg, fg);
+	cfb_imageblit_ref(rs, 1, 20, odd_img, 16, 11, fg, bg);
+	cfb_imageblit_ref(rs, 6, 40, odd_img, 9, 11, bg, fg);
+	lcd_expand_table_update(&tab, bg, fg, bpp);
+	lcd_expand_mono(&tab, (uint8_t *)lcd_surface_row(os, 5) + 3 * os->pixel_width,
+			os->stride, odd_img, 3, 21, 11);
+	lcd_expand_table_update(&tab, fg, bg, bpp);
+	lcd_expand_mono(&tab, (uint8_t *)lcd_surface_row(os, 20) + 1 * os->pixel_width,
+			os->stride, odd_img, 2, 16, 11);
+	lcd_expand_table_update(&tab, bg, fg, bpp);
+	lcd_expand_mono(&tab, (uint8_t *)lcd_surface_row(os, 40) + 6 * os->pixel_width,
+			os->stride, odd_img, 2, 9, 11);
+
+	ok = surface_equal(rs, os);
+	printf("%-5u %-4d %14.3f %14.3f %7.2fx %s\n", bpp, dx, t_cfb, t_lut, t_cfb / t_lut,
+	       ok ? "ok" : "MISMATCH");
+	lcd_display_close(ref);
+	lcd_display_close(out);
+	return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	int loops = (argc > 1) ? atoi(argv[1]) : 50;
+	uint8_t *line_img, odd_img[3 * 11];
+	unsigned int i;
+	int ret = 0;
+
+	if (loops < 1)
+		loops = 1;
+	/* 随机字形, 宽1024像素(128个字符), 高16行 */
+	line_img = malloc(1024 / 8 * FONT_H);
+	srand(1);
+	for (i = 0; i < 1024 / 8 * FONT_H; i++)
+		line_img[i] = rand();
+	for (i = 0; i < sizeof(odd_img); i++)
+		odd_img[i] = rand();
+
+	printf("1024x600, 8x16 glyphs, %d screens per run\n", loops);
+	printf("%-5s %-4s %14s %14s %8s %s\n", "bpp", "dx", "cfb ms/screen", "lut ms/screen",
+	       "speedup", "check");
+	/* 16bpp奇数dx时cfb走slow路径, 查表方式先写一个像素再按字写 */
+	ret |= bench_one(16, 0, line_img, odd_img, loops);
+	ret |= bench_one(16, 1, line_img, odd_img, loops);
+	ret |= bench_one(32, 0, line_img, odd_img, loops);
+
+	free(line_img);
+	return ret;
+}
@@ -0,0 +1,204 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#include "lcd_fb.h"
+
+/**********************************************************************
+ * 文件说明： 多实例检查: 两个fb实例互不影响
+ * 			  显存各自独立、在一个实例上present/pan不改变另一个的fence状态和yoffset、
+ * 			  两个实例同时present时各自按自己的场同步显示
+ * 用     法:  insmod lcd_driver_fb_device_tree.ko mem_instances=2
+ * 			  ./lcd_instance_check /dev/fbA /dev/fbB [次数]
+ * 				两个设备都要支持MYLCDIO_PRESENT, 至少2个buffer, 每项打印ok/FAIL
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -o lcd_instance_check \
+ * 				lcd_instance_check.c lcd_fb.c
+ ***********************************************************************/
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* 驱动中当前的yoffset */
+static unsigned int driver_yoffset(struct lcd_display *disp)
+{
+	struct fb_var_screeninfo var;
+
+	if (ioctl(disp->fd, FBIOGET_VSCREENINFO, &var))
+		return ~0u;
+	return var.yoffset;
+}
+
+/* 等待已提交的帧都开始显示 */
+static int wait_displayed(struct lcd_display *disp)
+{
+	struct pollfd pfd;
+
+	pfd.fd = lcd_display_event_fd(disp);
+	pfd.events = POLLIN;
+	if (pfd.fd < 0)
+		return -1;
+	lcd_display_dispatch(disp);
+	while (disp->status.displayed < disp->status.submitted) {
+		if (poll(&pfd, 1, 1000) <= 0)
+			return -1;
+		lcd_display_dispatch(disp);
+	}
+	return 0;
+}
+
+/* 所有buffer都是同一种颜色 */
+static int all_buffers_are(struct lcd_display *disp, unsigned int rgb)
+{
+	unsigned int i, x, y, pixel;
+	struct lcd_surface *s;
+
+	for (i = 0; i < disp->nbuffers; i++) {
+		s = lcd_display_buffer(disp, i);
+		pixel = lcd_color_pack(s->format, rgb);
+		for (y = 0; y < s->height; y++) {
+			unsigned char *row = lcd_surface_row(s, y);
+
+			for (x = 0; x < s->width; x++) {
+				unsigned int v;
+
+				switch (s->pixel_width) {
+				case 1:
+					v = row[x];
+					break;
+				case 2:
+					v = ((uint16_t *)row)[x];
+					break;
+				default:
+					v = ((uint32_t *)row)[x];
+					break;
+				}
+				if (v != pixel)
+					return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void fill_all(struct lcd_display *disp, unsigned int rgb)
+{
+	unsigned int i;
+
+	for (i = 0; i < disp->nbuffers; i++)
+		lcd_surface_fill(lcd_display_buffer(disp, i), rgb);
+}
+
+/* 在disp上依次present loops帧, 每帧等它开始显示 */
+static int present_frames(struct lcd_display *disp, int loops)
+{
+	int i;
+
+	for (i = 0; i < loops; i++) {
+		if (lcd_display_present(disp, (disp->front + 1) % disp->nbuffers) ||
+		    wait_displayed(disp))
+			return -1;
+	}
+	return 0;
+}
+
+static int report(const char *name, int ok)
+{
+	printf("check %-32s %s\n", name, ok ? "ok" : "FAIL");
+	return !ok;
+}
+
+int main(int argc, char **argv)
+{
+	int loops = (argc > 3) ? atoi(argv[3]) : 30;
+	struct lcd_display *a, *b;
+	struct mylcd_present_status sa, sb;
+	unsigned int yoff_b;
+	double t0, t;
+	int i, fails = 0, ok;
+
+	if (argc < 3) {
+		printf("Usage: %s /dev/fbA /dev/fbB [loops]\n", argv[0]);
+		return -1;
+	}
+	if (loops < 1)
+		loops = 1;
+	a = lcd_display_open(argv[1], 2);
+	b = lcd_display_open(argv[2], 2);
+	if (!a || !b)
+		return -1;
+	if (a->present_emulated || b->present_emulated || a->nbuffers < 2 || b->nbuffers < 2) {
+		printf("both devices need MYLCDIO_PRESENT and 2 buffers\n");
+		return -1;
+	}
+	if (wait_displayed(a) || wait_displayed(b)) {
+		printf("no vsync\n");
+		return -1;
+	}
+
+	/* 1. 显存独立: 写A的全部buffer, B的内容不变 */
+	fill_all(b, 0x0000ff00);
+	fill_all(a, 0x00ff0000);
+	ok = a->fix.smem_start != b->fix.smem_start && all_buffers_are(b, 0x0000ff00);
+	fails += report("separate VRAM", ok);
+
+	/* 2. 只在A上present: B的fence和yoffset不变, B的场同步照常 */
+	sb = b->status;
+	yoff_b = driver_yoffset(b);
+	sa = a->status;
+	ok = present_frames(a, loops) == 0 &&
+	     a->status.submitted == sa.submitted + loops &&
+	     a->status.displayed == a->status.submitted;
+	lcd_display_dispatch(b);
+	ok = ok && b->status.submitted == sb.submitted && b->status.displayed == sb.displayed &&
+	     b->status.vsync_count > sb.vsync_count && driver_yoffset(b) == yoff_b;
+	fails += report("present on A leaves B alone", ok);
+
+	/* 3. 只在A上pan: A的yoffset跟着变, B的不变 */
+	yoff_b = driver_yoffset(b);
+	ok = lcd_display_pan(a, a->var.yres) == 0 && driver_yoffset(a) == a->var.yres &&
+	     driver_yoffset(b) == yoff_b;
+	ok = ok && lcd_display_pan(a, 0) == 0 && driver_yoffset(a) == 0 &&
+	     driver_yoffset(b) == yoff_b;
+	fails += report("pan on A leaves B alone", ok);
+
+	/* 4. 两个实例交替present, 各自的序号只随自己的提交增加 */
+	wait_displayed(a);
+	wait_displayed(b);
+	sa = a->status;
+	sb = b->status;
+	ok = 1;
+	t0 = now_ms();
+	for (i = 0; i < loops && ok; i++) {
+		ok = lcd_display_present(a, (a->front + 1) % a->nbuffers) == 0 &&
+		     lcd_display_present(b, (b->front + 1) % b->nbuffers) == 0 &&
+		     wait_displayed(a) == 0 && wait_displayed(b) == 0;
+	}
+	t = now_ms() - t0;
+	ok = ok && a->status.submitted == sa.submitted + loops &&
+	     b->status.submitted == sb.submitted + loops &&
+	     a->status.displayed == a->status.submitted &&
+	     b->status.displayed == b->status.submitted;
+	fails += report("interleaved presents", ok);
+	if (ok)
+		printf("%d frames on each instance in %.1f ms (%.1f fps each)\n", loops, t,
+		       loops * 1000.0 / t);
+
+	/* present不写显存, B的画面仍然不变 */
+	fails += report("B VRAM untouched at the end", all_buffers_are(b, 0x0000ff00));
+
+	lcd_display_pan(a, 0);
+	lcd_display_pan(b, 0);
+	lcd_display_close(a);
+	lcd_display_close(b);
+	return fails ? -1 : 0;
+}
@@ -0,0 +1,39 @@
+#ifndef _LCD_IOCTL_H
+#define _LCD_IOCTL_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * 驱动私有ioctl, 内核驱动和应用程序共用
+ * 异步显示: 提交的每一帧得到一个递增的序号(fence),
+ * 场同步中断中该帧开始扫描时 displayed 更新, 上一帧不再被扫描时 released 更新,
+ * 两者变化时通知通过 MYLCDIO_SET_EVENTFD 注册的eventfd, 应用可以用poll等待
+ */
+
+struct mylcd_present {
+	__u32 yoffset;		/* 输入: 要显示的画面在虚拟屏幕中的y偏移 */
+	__u32 flags;		/* 保留, 填0 */
+	__u64 seqno;		/* 输出: 本次提交的序号 */
+};
+
+struct mylcd_present_status {
+	__u64 submitted;	/* 最后提交的序号 */
+	__u64 displayed;	/* 当前正在扫描的序号 */
+	__u64 released;		/* 最后释放的序号, 小于displayed的帧都不再被扫描 */
+	__u64 vsync_count;	/* 场同步次数 */
+	__u64 vsync_ns;		/* 最后一次场同步的时间(CLOCK_MONOTONIC) */
+};
+
+#define MYLCD_IOC_MAGIC		'L'
+
+/* 提交一帧, 立即返回; 队列满时返回EBUSY */
+#define MYLCDIO_PRESENT		_IOWR(MYLCD_IOC_MAGIC, 0x40, struct mylcd_present)
+/* 读取fence状态 */
+#define MYLCDIO_GET_STATUS	_IOR(MYLCD_IOC_MAGIC, 0x41, struct mylcd_present_status)
+/* 注册eventfd, -1表示取消 */
+#define MYLCDIO_SET_EVENTFD	_IOW(MYLCD_IOC_MAGIC, 0x42, __s32)
+/* 阻塞直到指定序号开始显示 */
+#define MYLCDIO_WAIT_DISPLAYED	_IOW(MYLCD_IOC_MAGIC, 0x43, __u64)
+
+#endif /* _LCD_IOCTL_H */
@@ -0,0 +1,134 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcd_fb.h"
+
+/**********************************************************************
+ * 文件说明： 8bpp调色板与16bpp RGB565的带宽对比
+ * 			  每种格式: 每帧字节数, 按刷新率计算的扫描带宽, 以及CPU整屏更新的耗时
+ * 用     法:  ./lcd_palette_bench [/dev/fbN] [次数]
+ * 				不指定设备时在1024x600的内存surface上测试, 刷新率按60Hz计算
+ * 				指定设备时切换驱动的bpp, 并读取驱动统计的scanout_bandwidth
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -o lcd_palette_bench \
+ * 				lcd_palette_bench.c lcd_fb.c
+ ***********************************************************************/
+
+#define REFRESH_HZ	60
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* 3-3-2 调色板, 与常见的256色HMI调色板相同 */
+static void palette_332(unsigned int *rgb)
+{
+	unsigned int i;
+
+	for (i = 0; i < 256; i++)
+		rgb[i] = (((i >> 5) & 7) * 255 / 7) << 16 |
+			 (((i >> 2) & 7) * 255 / 7) << 8 |
+			 ((i & 3) * 255 / 3);
+}
+
+/* 读取 /sys/class/graphics/fbN/device/scanout_bandwidth */
+static void print_driver_bandwidth(const char *dev)
+{
+	const char *name = strrchr(dev, '/');
+	char path[128], line[128];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/sys/class/graphics/%s/device/scanout_bandwidth",
+		 name ? name + 1 : dev);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+	if (fgets(line, sizeof(line), fp))
+		printf("      driver: %s", line);
+	fclose(fp);
+}
+
+/* 从内存中的画面整屏拷贝到显示buffer, 模拟界面刷新 */
+static double update_ms(struct lcd_surface *dst, const unsigned char *src, int loops)
+{
+	size_t row = (size_t)dst->width * dst->pixel_width;
+	unsigned int y;
+	double t0;
+	int n;
+
+	t0 = now_ms();
+	for (n = 0; n < loops; n++)
+		for (y = 0; y < dst->height; y++)
+			memcpy(lcd_surface_row(dst, y), src + y * row, row);
+	return (now_ms() - t0) / loops;
+}
+
+static int run(struct lcd_display *disp, const char *dev, int loops)
+{
+	struct lcd_surface *s = lcd_display_buffer(disp, 0);
+	size_t frame = (size_t)s->width * s->height * s->pixel_width;
+	unsigned char *src = malloc(frame);
+	unsigned int i;
+	double t;
+
+	if (!src)
+		return -1;
+	for (i = 0; i < frame; i++)
+		src[i] = rand();
+
+	t = update_ms(s, src, loops);
+	printf("%-4u %10zu %10.1f %12.3f %8u\n", disp->var.bits_per_pixel, frame,
+	       frame * (double)REFRESH_HZ / (1024 * 1024), t, disp->nbuffers);
+	if (dev)
+		print_driver_bandwidth(dev);
+	free(src);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = (argc > 1) ? argv[1] : NULL;
+	int loops = (argc > 2) ? atoi(argv[2]) : 100;
+	unsigned int bpps[] = { 16, 8 };
+	unsigned int pal[256];
+	struct lcd_display *disp = NULL;
+	unsigned int k, orig_bpp = 0;
+
+	if (loops < 1)
+		loops = 1;
+	palette_332(pal);
+
+	printf("%-4s %10s %10s %12s %8s\n", "bpp", "bytes/frm", "MB/s@60Hz", "update ms", "buffers");
+	if (dev) {
+		disp = lcd_display_open(dev, 0);
+		if (!disp)
+			return -1;
+		orig_bpp = disp->var.bits_per_pixel;
+	}
+	for (k = 0; k < sizeof(bpps) / sizeof(bpps[0]); k++) {
+		if (!dev) {
+			/* 与16bpp相同大小的显存 */
+			disp = lcd_display_open_mem(1024, 600, bpps[k], 2 * 16 / bpps[k]);
+			if (!disp)
+				return -1;
+		} else if (lcd_display_set_bpp(disp, bpps[k])) {
+			continue;
+		}
+		if (bpps[k] == 8)
+			lcd_display_set_palette(disp, 0, 256, pal);
+		run(disp, dev, loops);
+		if (!dev)
+			lcd_display_close(disp);
+	}
+	if (dev) {
+		lcd_display_set_bpp(disp, orig_bpp);
+		lcd_display_close(disp);
+	}
+	return 0;
+}
@@ -0,0 +1,202 @@
+#ifndef _LCD_PRESENT_H
+#define _LCD_PRESENT_H
+
+/*
+ * 异步显示队列, LCDIF驱动和虚拟显示驱动共用
+ * MYLCDIO_PRESENT提交的帧按顺序排队, 场同步(帧结束)时每次取出一帧交给控制器(NEXT_BUF);
+ * 当控制器开始扫描该帧(CUR_BUF变为该帧地址)时说明它已开始显示, 同时上一帧被释放
+ * 写NEXT_BUF由驱动提供的program函数完成, 它在持有lock时调用, 不能睡眠
+ */
+
+#include <linux/eventfd.h>
+#include <linux/fb.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+
+#include "lcd_ioctl.h"
+
+#define LCD_PRESENT_QUEUE	4
+
+struct lcd_present_entry {
+	dma_addr_t addr;
+	u64 seqno;
+};
+
+struct lcd_present_queue;
+typedef void (*lcd_present_program_fn)(struct lcd_present_queue *present, dma_addr_t addr);
+
+struct lcd_present_queue {
+	spinlock_t lock;
+	struct lcd_present_entry q[LCD_PRESENT_QUEUE];
+	unsigned int head;		/* 队首下标 */
+	unsigned int count;		/* 排队的帧数 */
+	struct lcd_present_entry pending;	/* 已写入NEXT_BUF, 等待生效 */
+	bool has_pending;
+	struct mylcd_present_status status;
+	struct eventfd_ctx *efd;	/* 状态变化时通知应用 */
+	wait_queue_head_t wait;
+	lcd_present_program_fn program;	/* 把地址写入NEXT_BUF */
+};
+
+static inline void lcd_present_init(struct lcd_present_queue *present,
+				    lcd_present_program_fn program)
+{
+	spin_lock_init(&present->lock);
+	init_waitqueue_head(&present->wait);
+	present->program = program;
+}
+
+/* 把一帧交给控制器, 调用者持有lock */
+static inline void lcd_present_program(struct lcd_present_queue *present,
+				       const struct lcd_present_entry *e)
+{
+	present->program(present, e->addr);
+	present->pending = *e;
+	present->has_pending = true;
+}
+
+/*
+ * 场同步时调用(中断或hrtimer), cur为控制器正在扫描的地址(CUR_BUF)
+ * 更新fence并把队列中的下一帧交给控制器, 返回场同步计数
+ */
+static inline u64 lcd_present_vsync(struct lcd_present_queue *present, dma_addr_t cur)
+{
+	unsigned long flags;
+	u64 vsync;
+
+	spin_lock_irqsave(&present->lock, flags);
+	vsync = ++present->status.vsync_count;
+	present->status.vsync_ns = ktime_get_ns();
+
+	/* 待生效的帧开始扫描, 上一帧释放 */
+	if (present->has_pending && cur == present->pending.addr) {
+		present->has_pending = false;
+		present->status.released = present->status.displayed;
+		present->status.displayed = present->pending.seqno;
+	}
+
+	if (!present->has_pending && present->count) {
+		lcd_present_program(present, &present->q[present->head]);
+		present->head = (present->head + 1) % LCD_PRESENT_QUEUE;
+		present->count--;
+	}
+
+	wake_up_all(&present->wait);
+	if (present->efd)
+		eventfd_signal(present->efd, 1);
+	spin_unlock_irqrestore(&present->lock, flags);
+	return vsync;
+}
+
+/*
+ * 提交一帧
+ * mailbox为真时(pan_display)丢弃还在排队的帧, 新帧直接写入NEXT_BUF;
+ * 否则(MYLCDIO_PRESENT)按顺序排队, 由场同步依次送显, 队列满时返回-EBUSY
+ */
+static inline int lcd_present_submit(struct lcd_present_queue *present, dma_addr_t addr,
+				     bool mailbox, u64 *seqno)
+{
+	struct lcd_present_entry e;
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&present->lock, flags);
+	e.addr = addr;
+	e.seqno = present->status.submitted + 1;
+
+	if (mailbox) {
+		/* 被丢弃的帧不会显示, 视为立即释放 */
+		present->count = 0;
+		lcd_present_program(present, &e);
+	} else if (present->count == LCD_PRESENT_QUEUE) {
+		ret = -EBUSY;
+	} else if (!present->has_pending && !present->count) {
+		lcd_present_program(present, &e);
+	} else {
+		present->q[(present->head + present->count) % LCD_PRESENT_QUEUE] = e;
+		present->count++;
+	}
+
+	if (!ret) {
+		present->status.submitted = e.seqno;
+		if (seqno)
+			*seqno = e.seqno;
+	}
+	spin_unlock_irqrestore(&present->lock, flags);
+	return ret;
+}
+
+/* MYLCDIO_PRESENT以外的私有ioctl和FBIO_WAITFORVSYNC, 不认识的命令返回-ENOTTY */
+static inline int lcd_present_ioctl(struct lcd_present_queue *present, unsigned int cmd,
+				    void __user *argp)
+{
+	struct mylcd_present_status status;
+	struct eventfd_ctx *efd, *old;
+	unsigned long flags;
+	u64 seqno, vsync;
+	s32 fd;
+	long ret;
+
+	switch (cmd) {
+	case MYLCDIO_GET_STATUS:
+		spin_lock_irqsave(&present->lock, flags);
+		status = present->status;
+		spin_unlock_irqrestore(&present->lock, flags);
+		return copy_to_user(argp, &status, sizeof(status)) ? -EFAULT : 0;
+
+	case MYLCDIO_SET_EVENTFD:
+		if (get_user(fd, (s32 __user *)argp))
+			return -EFAULT;
+		efd = NULL;
+		if (fd >= 0) {
+			efd = eventfd_ctx_fdget(fd);
+			if (IS_ERR(efd))
+				return PTR_ERR(efd);
+		}
+		spin_lock_irqsave(&present->lock, flags);
+		old = present->efd;
+		present->efd = efd;
+		spin_unlock_irqrestore(&present->lock, flags);
+		if (old)
+			eventfd_ctx_put(old);
+		return 0;
+
+	case MYLCDIO_WAIT_DISPLAYED:
+		if (get_user(seqno, (u64 __user *)argp))
+			return -EFAULT;
+		ret = wait_event_interruptible_timeout(present->wait,
+				READ_ONCE(present->status.displayed) >= seqno, HZ);
+		if (ret < 0)
+			return ret;
+		return ret ? 0 : -ETIMEDOUT;
+
+	case FBIO_WAITFORVSYNC:
+		vsync = READ_ONCE(present->status.vsync_count);
+		ret = wait_event_interruptible_timeout(present->wait,
+				READ_ONCE(present->status.vsync_count) != vsync, HZ);
+		if (ret < 0)
+			return ret;
+		return ret ? 0 : -ETIMEDOUT;
+	}
+
+	return -ENOTTY;
+}
+
+/* 注销eventfd, 场同步停止后调用 */
+static inline void lcd_present_release(struct lcd_present_queue *present)
+{
+	struct eventfd_ctx *efd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&present->lock, flags);
+	efd = present->efd;
+	present->efd = NULL;
+	spin_unlock_irqrestore(&present->lock, flags);
+	if (efd)
+		eventfd_ctx_put(efd);
+}
+
+#endif /* _LCD_PRESENT_H */
@@ -0,0 +1,370 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lcd_raster.h"
+
+#define FIX_SHIFT	16
+#define FIX_ONE		(1 << FIX_SHIFT)
+#define FIX_HALF	(1 << (FIX_SHIFT - 1))
+
+/* 多边形边数不超过此值时边表放在栈上, 否则malloc */
+#define RASTER_STACK_EDGES	64
+
+void lcd_raster_init(struct lcd_raster *r, struct lcd_surface *s)
+{
+	r->s = s;
+	r->span = lcd_surface_span_fn(s->format);
+	lcd_raster_set_clip(r, 0, 0, s->width, s->height);
+	lcd_raster_set_color(r, 0);
+}
+
+void lcd_raster_set_clip(struct lcd_raster *r, int x, int y, int w, int h)
+{
+	r->clip_x0 = x < 0 ? 0 : x;
+	r->clip_y0 = y < 0 ? 0 : y;
+	r->clip_x1 = x + w > (int)r->s->width ? (int)r->s->width : x + w;
+	r->clip_y1 = y + h > (int)r->s->height ? (int)r->s->height : y + h;
+}
+
+void lcd_raster_set_color(struct lcd_raster *r, unsigned int rgb)
+{
+	r->rgb = rgb;
+	r->pixel = lcd_color_pack(r->s->format, rgb);
+}
+
+/* 裁剪后填充第y行的 [xa, xb], 两端都包含 */
+static inline void raster_hspan(struct lcd_raster *r, int xa, int xb, int y)
+{
+	if (y < r->clip_y0 || y >= r->clip_y1)
+		return;
+	if (xa < r->clip_x0)
+		xa = r->clip_x0;
+	if (xb >= r->clip_x1)
+		xb = r->clip_x1 - 1;
+	if (xa <= xb)
+		r->span(r->s, xa, y, xb - xa + 1, r->pixel);
+}
+
+/**********************************************************************
+ * 函数名称： lcd_raster_line
+ * 功能描述： 画直线，包括两个端点
+ * 输入参数： raster，起点，终点
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 注     意:  偏水平的直线按x步进，同一行连续的点合并成一个span一次写出;
+ * 			  偏竖直的直线每行只有一个点; 只步进裁剪矩形内的部分
+ ***********************************************************************/
+void lcd_raster_line(struct lcd_raster *r, int x0, int y0, int x1, int y1)
+{
+	int dx = x1 - x0, dy = y1 - y0;
+	int64_t first, last;
+	int32_t slope, f;
+	int start, end, run, row, i;
+
+	if (abs(dx) >= abs(dy)) {
+		if (dx < 0) {
+			x0 = x1;
+			y0 = y1;
+			dx = -dx;
+			dy = -dy;
+		}
+		if (dy == 0) {
+			raster_hspan(r, x0, x0 + dx, y0);
+			return;
+		}
+		slope = (int64_t)dy * FIX_ONE / dx;
+		start = x0 < r->clip_x0 ? r->clip_x0 : x0;
+		end = x0 + dx >= r->clip_x1 ? r->clip_x1 - 1 : x0 + dx;
+		if (start > end)
+			return;
+
+		/*
+		 * 加0.5后取整, 即四舍五入到最近的行
+		 * 起点和终点的行用64位算, 相对于裁剪矩形的上边; 都在裁剪区同一侧时不用画,
+		 * 否则逐列累加的值不超过裁剪区的宽+高, 用32位
+		 */
+		first = (int64_t)(y0 - r->clip_y0) * FIX_ONE + FIX_HALF + (int64_t)(start - x0) * slope;
+		last = first + (int64_t)(end - start) * slope;
+		if ((first < 0 && last < 0) ||
+		    ((first >> FIX_SHIFT) >= r->clip_y1 - r->clip_y0 &&
+		     (last >> FIX_SHIFT) >= r->clip_y1 - r->clip_y0))
+			return;
+		f = first;
+		run = start;
+		row = f >> FIX_SHIFT;
+		for (i = start + 1; i <= end; i++) {
+			f += slope;
+			if ((f >> FIX_SHIFT) != row) {
+				raster_hspan(r, run, i - 1, r->clip_y0 + row);
+				run = i;
+				row = f >> FIX_SHIFT;
+			}
+		}
+		raster_hspan(r, run, end, r->clip_y0 + row);
+	} else {
+		if (dy < 0) {
+			x0 = x1;
+			y0 = y1;
+			dx = -dx;
+			dy = -dy;
+		}
+		slope = (int64_t)dx * FIX_ONE / dy;
+		start = y0 < r->clip_y0 ? r->clip_y0 : y0;
+		end = y0 + dy >= r->clip_y1 ? r->clip_y1 - 1 : y0 + dy;
+		if (start > end)
+			return;
+
+		/* 同上, x相对于裁剪矩形的左边 */
+		first = (int64_t)(x0 - r->clip_x0) * FIX_ONE + FIX_HALF + (int64_t)(start - y0) * slope;
+		last = first + (int64_t)(end - start) * slope;
+		if ((first < 0 && last < 0) ||
+		    ((first >> FIX_SHIFT) >= r->clip_x1 - r->clip_x0 &&
+		     (last >> FIX_SHIFT) >= r->clip_x1 - r->clip_x0))
+			return;
+		f = first;
+		for (i = start; i <= end; i++, f += slope)
+			raster_hspan(r, r->clip_x0 + (f >> FIX_SHIFT), r->clip_x0 + (f >> FIX_SHIFT), i);
+	}
+}
+
+void lcd_raster_polyline(struct lcd_raster *r, const struct lcd_point *pts, int n, int closed)
+{
+	int i;
+
+	for (i = 0; i + 1 < n; i++)
+		lcd_raster_line(r, pts[i].x, pts[i].y, pts[i + 1].x, pts[i + 1].y);
+	if (closed && n > 2)
+		lcd_raster_line(r, pts[n - 1].x, pts[n - 1].y, pts[0].x, pts[0].y);
+}
+
+/*
+ * 多边形的一条边, 覆盖第y0行到第y1-1行
+ * x和增量用64位: 顶点可以远在裁剪区外(图表数据缩放后超出屏幕),
+ * 这时边在裁剪区内的x仍可能超出16.16定点数的范围(±32768)
+ */
+struct raster_edge {
+	int y0, y1;
+	int64_t x;	/* 当前行的x, 16.16定点 */
+	int64_t dxdy;	/* 每下移一行x的增量 */
+};
+
+/* 16.16定点数向上取整, 限制在裁剪矩形附近, 结果可以安全地转换为int */
+static inline int raster_ceil_clip(const struct lcd_raster *r, int64_t x)
+{
+	x = (x + FIX_ONE - 1) >> FIX_SHIFT;
+	if (x < r->clip_x0 - 1)
+		return r->clip_x0 - 1;
+	return x > r->clip_x1 ? r->clip_x1 : x;
+}
+
+static int edge_cmp(const void *a, const void *b)
+{
+	return ((const struct raster_edge *)a)->y0 - ((const struct raster_edge *)b)->y0;
+}
+
+/**********************************************************************
+ * 函数名称： lcd_raster_fill_polygon
+ * 功能描述： 按奇偶规则填充多边形
+ * 输入参数： raster，顶点数组，顶点个数
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 注     意:  边按起始行排序后逐行扫描: 活动边的x用定点数逐行累加,
+ * 			  按x排序后每两个交点之间是一个span; 只扫描裁剪矩形内的行
+ ***********************************************************************/
+void lcd_raster_fill_polygon(struct lcd_raster *r, const struct lcd_point *pts, int n)
+{
+	struct raster_edge stack_edges[RASTER_STACK_EDGES];
+	struct raster_edge *stack_active[RASTER_STACK_EDGES];
+	struct raster_edge *edges = stack_edges, **active = stack_active;
+	struct raster_edge *e, *t;
+	int nedges = 0, nactive, next, i, j, y, ymin, ymax;
+	const struct lcd_point *p, *q;
+
+	if (n < 3)
+		return;
+	if (n > RASTER_STACK_EDGES) {
+		edges = malloc(n * (sizeof(*edges) + sizeof(*active)));
+		if (!edges)
+			return;
+		active = (struct raster_edge **)(edges + n);
+	}
+
+	/* 建立边表, 水平边不与任何扫描线相交, 忽略 */
+	ymin = r->clip_y1;
+	ymax = r->clip_y0;
+	for (i = 0; i < n; i++) {
+		p = &pts[i];
+		q = &pts[(i + 1) % n];
+		if (p->y == q->y)
+			continue;
+		if (p->y > q->y) {
+			const struct lcd_point *tmp = p;
+
+			p = q;
+			q = tmp;
+		}
+		e = &edges[nedges++];
+		e->y0 = p->y;
+		e->y1 = q->y;
+		e->x = (int64_t)p->x * FIX_ONE;
+		e->dxdy = (int64_t)(q->x - p->x) * FIX_ONE / (q->y - p->y);
+		if (e->y0 < ymin)
+			ymin = e->y0;
+		if (e->y1 > ymax)
+			ymax = e->y1;
+	}
+	qsort(edges, nedges, sizeof(*edges), edge_cmp);
+
+	if (ymin < r->clip_y0)
+		ymin = r->clip_y0;
+	if (ymax > r->clip_y1)
+		ymax = r->clip_y1;
+
+	nactive = 0;
+	next = 0;
+	for (y = ymin; y < ymax; y++) {
+		/* 加入从本行开始的边, 起点在裁剪区上方的边直接算出本行的x */
+		for (; next < nedges && edges[next].y0 <= y; next++) {
+			e = &edges[next];
+			if (e->y1 <= y)
+				continue;
+			if (e->y0 < y)
+				e->x += (int64_t)(y - e->y0) * e->dxdy;
+			active[nactive++] = e;
+		}
+		/* 去掉已经结束的边 */
+		for (i = j = 0; i < nactive; i++)
+			if (active[i]->y1 > y)
+				active[j++] = active[i];
+		nactive = j;
+
+		/* 按x插入排序, 活动边很少且逐行变化不大 */
+		for (i = 1; i < nactive; i++) {
+			t = active[i];
+			for (j = i; j > 0 && active[j - 1]->x > t->x; j--)
+				active[j] = active[j - 1];
+			active[j] = t;
+		}
+
+		/* 像素中心x满足 xa <= x < xb 时填充 */
+		for (i = 0; i + 1 < nactive; i += 2)
+			raster_hspan(r, raster_ceil_clip(r, active[i]->x),
+				     raster_ceil_clip(r, active[i + 1]->x) - 1, y);
+
+		for (i = 0; i < nactive; i++)
+			active[i]->x += active[i]->dxdy;
+	}
+
+	if (edges != stack_edges)
+		free(edges);
+}
+
+void lcd_raster_fill_rect(struct lcd_raster *r, int x, int y, int w, int h)
+{
+	int j, end;
+
+	if (w <= 0)
+		return;
+	end = y + h < r->clip_y1 ? y + h : r->clip_y1;
+	for (j = y < r->clip_y0 ? r->clip_y0 : y; j < end; j++)
+		raster_hspan(r, x, x + w - 1, j);
+}
+
+/*
+ * 圆角: 1/4圆上第dy行(距圆心)的最大x满足 x*x + dy*dy <= r*r + r,
+ * 即按半径r+0.5取整; dy递增时x单调递减, 整个1/4圆只需整数加减比较
+ */
+static inline int arc_step(int x, int dy, int64_t r2)
+{
+	while (x > 0 && (int64_t)x * x + (int64_t)dy * dy > r2)
+		x--;
+	return x;
+}
+
+/*
+ * 圆角矩形边框, 四个圆角的圆心为(lx,ty) (rx,ty) (lx,by) (rx,by)
+ * 每行画出圆弧从本行到下一行之间的那一段, 保证相邻行的点互相连通
+ */
+static void raster_round_outline(struct lcd_raster *r, int lx, int rx, int ty, int by,
+				 int radius)
+{
+	int64_t r2 = (int64_t)radius * radius + radius;
+	int dy, x, xn, a, y;
+
+	x = radius;
+	for (dy = 0; dy <= radius; dy++) {
+		xn = dy < radius ? arc_step(x, dy + 1, r2) : 0;
+		a = dy < radius ? (xn + 1 < x ? xn + 1 : x) : 0;
+		if (a == 0) {
+			/* 最上/最下一行, 包括两个圆角之间的直边 */
+			raster_hspan(r, lx - x, rx + x, ty - dy);
+			raster_hspan(r, lx - x, rx + x, by + dy);
+		} else {
+			raster_hspan(r, lx - x, lx - a, ty - dy);
+			raster_hspan(r, rx + a, rx + x, ty - dy);
+			raster_hspan(r, lx - x, lx - a, by + dy);
+			raster_hspan(r, rx + a, rx + x, by + dy);
+		}
+		x = xn;
+	}
+	/* 左右两条竖直边 */
+	for (y = ty + 1 > r->clip_y0 ? ty + 1 : r->clip_y0; y < by && y < r->clip_y1; y++) {
+		raster_hspan(r, lx - radius, lx - radius, y);
+		raster_hspan(r, rx + radius, rx + radius, y);
+	}
+}
+
+static void raster_round_fill(struct lcd_raster *r, int lx, int rx, int ty, int by, int radius)
+{
+	int64_t r2 = (int64_t)radius * radius + radius;
+	int dy, x = radius;
+
+	for (dy = 0; dy <= radius; dy++) {
+		x = arc_step(x, dy, r2);
+		raster_hspan(r, lx - x, rx + x, ty - dy);
+		if (by != ty || dy)
+			raster_hspan(r, lx - x, rx + x, by + dy);
+	}
+	if (by > ty + 1)
+		lcd_raster_fill_rect(r, lx - radius, ty + 1, rx - lx + 2 * radius + 1, by - ty - 1);
+}
+
+/* 圆角半径不超过宽高的一半 */
+static int round_radius(int w, int h, int radius)
+{
+	int max = ((w < h ? w : h) - 1) / 2;
+
+	if (radius < 0)
+		return 0;
+	return radius > max ? max : radius;
+}
+
+void lcd_raster_circle(struct lcd_raster *r, int cx, int cy, int radius)
+{
+	if (radius >= 0)
+		raster_round_outline(r, cx, cx, cy, cy, radius);
+}
+
+void lcd_raster_fill_circle(struct lcd_raster *r, int cx, int cy, int radius)
+{
+	if (radius >= 0)
+		raster_round_fill(r, cx, cx, cy, cy, radius);
+}
+
+void lcd_raster_round_rect(struct lcd_raster *r, int x, int y, int w, int h, int radius)
+{
+	if (w <= 0 || h <= 0)
+		return;
+	radius = round_radius(w, h, radius);
+	raster_round_outline(r, x + radius, x + w - 1 - radius, y + radius, y + h - 1 - radius,
+			     radius);
+}
+
+void lcd_raster_fill_round_rect(struct lcd_raster *r, int x, int y, int w, int h, int radius)
+{
+	if (w <= 0 || h <= 0)
+		return;
+	radius = round_radius(w, h, radius);
+	raster_round_fill(r, x + radius, x + w - 1 - radius, y + radius, y + h - 1 - radius,
+			  radius);
+}
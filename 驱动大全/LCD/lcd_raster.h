@@ -0,0 +1,49 @@
+#ifndef _LCD_RASTER_H
+#define _LCD_RASTER_H
+
+#include "lcd_fb.h"
+
+/*
+ * 2D图元光栅化: 直线、折线、多边形、圆、圆角矩形
+ * 所有图元先转换为水平的span(一行中连续的一段), 再交给lcd_fb.c中按像素格式选好的行填充函数,
+ * 不再逐点调用put_pixel; 边的步进使用16.16定点数
+ * 坐标为像素中心, 填充时像素中心落在图形内部(左闭右开)才填充,
+ * 所以 (0,0)-(10,0)-(10,10)-(0,10) 的多边形与 fill_rect(0,0,10,10) 覆盖相同的像素
+ * 坐标可以远在surface之外, 由裁剪处理; 坐标、宽高和半径的绝对值不超过2^28(不检查),
+ * surface宽高不超过16384, 这个范围内的中间结果都不会溢出
+ */
+
+struct lcd_point {
+	int x, y;
+};
+
+struct lcd_raster {
+	struct lcd_surface *s;
+	int clip_x0, clip_y0;	/* 裁剪矩形, 左上角(含) */
+	int clip_x1, clip_y1;	/* 裁剪矩形, 右下角(不含) */
+	unsigned int rgb;	/* 当前颜色0x00RRGGBB(8bpp时为调色板索引) */
+	unsigned int pixel;	/* 打包后的像素值 */
+	lcd_span_fn span;	/* lcd_surface_span_fn()选出的行填充函数 */
+};
+
+/* 初始化: 裁剪矩形为整个surface, 颜色为黑色 */
+void lcd_raster_init(struct lcd_raster *r, struct lcd_surface *s);
+/* 设置裁剪矩形, 与surface取交集 */
+void lcd_raster_set_clip(struct lcd_raster *r, int x, int y, int w, int h);
+void lcd_raster_set_color(struct lcd_raster *r, unsigned int rgb);
+
+/* 直线, 两个端点都画 */
+void lcd_raster_line(struct lcd_raster *r, int x0, int y0, int x1, int y1);
+/* 折线, closed非0时首尾相连(即多边形边框) */
+void lcd_raster_polyline(struct lcd_raster *r, const struct lcd_point *pts, int n, int closed);
+/* 填充多边形, 奇偶规则, 可以是凹多边形或自相交 */
+void lcd_raster_fill_polygon(struct lcd_raster *r, const struct lcd_point *pts, int n);
+
+void lcd_raster_fill_rect(struct lcd_raster *r, int x, int y, int w, int h);
+void lcd_raster_circle(struct lcd_raster *r, int cx, int cy, int radius);
+void lcd_raster_fill_circle(struct lcd_raster *r, int cx, int cy, int radius);
+/* 圆角矩形, 圆角半径超过宽高的一半时按一半计算 */
+void lcd_raster_round_rect(struct lcd_raster *r, int x, int y, int w, int h, int radius);
+void lcd_raster_fill_round_rect(struct lcd_raster *r, int x, int y, int w, int h, int radius);
+
+#endif /* _LCD_RASTER_H */
@@ -0,0 +1,682 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "lcd_fb.h"
+#include "lcd_raster.h"
+
+/**********************************************************************
+ * 文件说明： 图元光栅化性能: 按span填充 vs 逐点put_pixel的经典画法
+ * 			  对照组用Bresenham直线、中点画圆、逐点扫描线填充多边形, 每个点调用一次put_pixel;
+ * 			  两种画法的算法不同, 像素不完全一样, 只比较速度
+ * 			  正确性单独检查(与对照组无关):
+ * 			  矩形多边形与fill_rect相同、裁剪(画面边缘/裁剪矩形/空裁剪)不改变可见像素、
+ * 			  圆和圆角矩形对称、直线包含两个端点且每步一个点、反向画的直线相同
+ * 用     法:  ./lcd_raster_bench [次数] [bpp] [/dev/fbN]
+ * 				不指定设备时在1024x600的内存surface上测试, bpp默认16
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -o lcd_raster_bench \
+ * 				lcd_raster_bench.c lcd_raster.c lcd_fb.c -lm
+ ***********************************************************************/
+
+#define CHART_POINTS	256
+#define BARS		24
+#define SCENES		6
+
+#define CHECK_W		320
+#define CHECK_H		240
+#define CHECK_MARGIN	64	/* 平移检查时大surface每边多出的像素 */
+
+static const char *scene_names[SCENES] = {
+	"grid", "polyline", "area", "bars", "markers", "gauge",
+};
+
+/* 一组画图函数, 两种画法各一组 */
+struct draw_ops {
+	void (*line)(struct lcd_raster *r, int x0, int y0, int x1, int y1);
+	void (*polyline)(struct lcd_raster *r, const struct lcd_point *pts, int n, int closed);
+	void (*fill_polygon)(struct lcd_raster *r, const struct lcd_point *pts, int n);
+	void (*circle)(struct lcd_raster *r, int cx, int cy, int radius);
+	void (*fill_circle)(struct lcd_raster *r, int cx, int cy, int radius);
+	void (*round_rect)(struct lcd_raster *r, int x, int y, int w, int h, int radius);
+	void (*fill_round_rect)(struct lcd_raster *r, int x, int y, int w, int h, int radius);
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * 对照组: 逐点put_pixel, 只用r->s和r->rgb, 裁剪由put_pixel逐点判断
+ */
+static void plot(struct lcd_raster *r, int x, int y)
+{
+	lcd_surface_put_pixel(r->s, x, y, r->rgb);
+}
+
+static void plot_hline(struct lcd_raster *r, int xa, int xb, int y)
+{
+	for (; xa <= xb; xa++)
+		plot(r, xa, y);
+}
+
+/* Bresenham直线 */
+static void plot_line(struct lcd_raster *r, int x0, int y0, int x1, int y1)
+{
+	int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+	int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy, e2;
+
+	for (;;) {
+		plot(r, x0, y0);
+		if (x0 == x1 && y0 == y1)
+			break;
+		e2 = 2 * err;
+		if (e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+static void plot_polyline(struct lcd_raster *r, const struct lcd_point *pts, int n, int closed)
+{
+	int i;
+
+	for (i = 0; i + 1 < n; i++)
+		plot_line(r, pts[i].x, pts[i].y, pts[i + 1].x, pts[i + 1].y);
+	if (closed && n > 2)
+		plot_line(r, pts[n - 1].x, pts[n - 1].y, pts[0].x, pts[0].y);
+}
+
+/* 扫描线填充: 每行用浮点数求交点, 排序后逐点画 */
+static void plot_fill_polygon(struct lcd_raster *r, const struct lcd_point *pts, int n)
+{
+	static double xs[CHART_POINTS + 2];
+	int ymin = pts[0].y, ymax = pts[0].y, y, i, k, x;
+	double t;
+
+	if (n < 3 || n > CHART_POINTS + 2)
+		return;
+	for (i = 1; i < n; i++) {
+		if (pts[i].y < ymin)
+			ymin = pts[i].y;
+		if (pts[i].y > ymax)
+			ymax = pts[i].y;
+	}
+	if (ymin < 0)
+		ymin = 0;
+	if (ymax > (int)r->s->height)
+		ymax = r->s->height;
+
+	for (y = ymin; y < ymax; y++) {
+		for (i = k = 0; i < n; i++) {
+			const struct lcd_point *p = &pts[i], *q = &pts[(i + 1) % n];
+
+			if ((p->y <= y && y < q->y) || (q->y <= y && y < p->y))
+				xs[k++] = p->x + (double)(y - p->y) * (q->x - p->x) / (q->y - p->y);
+		}
+		for (i = 1; i < k; i++) {
+			t = xs[i];
+			for (x = i; x > 0 && xs[x - 1] > t; x--)
+				xs[x] = xs[x - 1];
+			xs[x] = t;
+		}
+		for (i = 0; i + 1 < k; i += 2)
+			for (x = (int)ceil(xs[i]); x < (int)ceil(xs[i + 1]); x++)
+				plot(r, x, y);
+	}
+}
+
+/*
+ * 中点画圆, 圆心在(lx,ty) (rx,ty) (lx,by) (rx,by)的四个1/4圆, 圆时四个圆心相同
+ * fill非0时每对对称点之间逐点画满, 再填中间的矩形
+ */
+static void plot_round(struct lcd_raster *r, int lx, int rx, int ty, int by, int radius, int fill)
+{
+	int x = radius, y = 0, err = 1 - radius;
+
+	if (radius < 0)
+		return;
+	while (x >= y) {
+		if (fill) {
+			plot_hline(r, lx - x, rx + x, ty - y);
+			plot_hline(r, lx - x, rx + x, by + y);
+			plot_hline(r, lx - y, rx + y, ty - x);
+			plot_hline(r, lx - y, rx + y, by + x);
+		} else {
+			plot(r, rx + x, by + y);
+			plot(r, lx - x, by + y);
+			plot(r, rx + x, ty - y);
+			plot(r, lx - x, ty - y);
+			plot(r, rx + y, by + x);
+			plot(r, lx - y, by + x);
+			plot(r, rx + y, ty - x);
+			plot(r, lx - y, ty - x);
+		}
+		y++;
+		if (err < 0) {
+			err += 2 * y + 1;
+		} else {
+			x--;
+			err += 2 * (y - x) + 1;
+		}
+	}
+	if (fill) {
+		for (y = ty + 1; y < by; y++)
+			plot_hline(r, lx - radius, rx + radius, y);
+	} else {
+		plot_line(r, lx, ty - radius, rx, ty - radius);
+		plot_line(r, lx, by + radius, rx, by + radius);
+		plot_line(r, lx - radius, ty, lx - radius, by);
+		plot_line(r, rx + radius, ty, rx + radius, by);
+	}
+}
+
+static void plot_circle(struct lcd_raster *r, int cx, int cy, int radius)
+{
+	plot_round(r, cx, cx, cy, cy, radius, 0);
+}
+
+static void plot_fill_circle(struct lcd_raster *r, int cx, int cy, int radius)
+{
+	plot_round(r, cx, cx, cy, cy, radius, 1);
+}
+
+static int plot_radius(int w, int h, int radius)
+{
+	int max = ((w < h ? w : h) - 1) / 2;
+
+	return radius < 0 ? 0 : (radius > max ? max : radius);
+}
+
+static void plot_round_rect(struct lcd_raster *r, int x, int y, int w, int h, int radius)
+{
+	if (w <= 0 || h <= 0)
+		return;
+	radius = plot_radius(w, h, radius);
+	plot_round(r, x + radius, x + w - 1 - radius, y + radius, y + h - 1 - radius, radius, 0);
+}
+
+static void plot_fill_round_rect(struct lcd_raster *r, int x, int y, int w, int h, int radius)
+{
+	if (w <= 0 || h <= 0)
+		return;
+	radius = plot_radius(w, h, radius);
+	plot_round(r, x + radius, x + w - 1 - radius, y + radius, y + h - 1 - radius, radius, 1);
+}
+
+static const struct draw_ops span_ops = {
+	lcd_raster_line, lcd_raster_polyline, lcd_raster_fill_polygon,
+	lcd_raster_circle, lcd_raster_fill_circle,
+	lcd_raster_round_rect, lcd_raster_fill_round_rect,
+};
+
+static const struct draw_ops plot_ops = {
+	plot_line, plot_polyline, plot_fill_polygon,
+	plot_circle, plot_fill_circle,
+	plot_round_rect, plot_fill_round_rect,
+};
+
+/* 画图表的第k部分, 数据随帧号n变化 */
+static void draw_scene(struct lcd_raster *r, const struct draw_ops *ops, int k, int n)
+{
+	struct lcd_surface *s = r->s;
+	static struct lcd_point pts[CHART_POINTS + 2];
+	struct lcd_point needle[4];
+	int x0 = 40, y0 = 40, w = s->width - 80, h = s->height - 80;
+	int i, x, bw;
+	double a;
+
+	for (i = 0; i < CHART_POINTS; i++) {
+		pts[i].x = x0 + i * (w - 1) / (CHART_POINTS - 1);
+		pts[i].y = y0 + h / 2 - (int)(h * 0.4 * sin(i * 0.05 + n * 0.1) *
+					      cos(i * 0.013 + n * 0.03));
+	}
+
+	switch (k) {
+	case 0:
+		lcd_raster_set_color(r, 0x00303030);
+		for (i = 0; i <= 10; i++)
+			ops->line(r, x0, y0 + i * (h - 1) / 10, x0 + w - 1, y0 + i * (h - 1) / 10);
+		for (i = 0; i <= 16; i++)
+			ops->line(r, x0 + i * (w - 1) / 16, y0, x0 + i * (w - 1) / 16, y0 + h - 1);
+		break;
+	case 1:
+		lcd_raster_set_color(r, 0x0000ff80);
+		ops->polyline(r, pts, CHART_POINTS, 0);
+		break;
+	case 2:
+		/* 曲线与底边围成的区域 */
+		pts[CHART_POINTS].x = x0 + w - 1;
+		pts[CHART_POINTS].y = y0 + h - 1;
+		pts[CHART_POINTS + 1].x = x0;
+		pts[CHART_POINTS + 1].y = y0 + h - 1;
+		lcd_raster_set_color(r, 0x00204060);
+		ops->fill_polygon(r, pts, CHART_POINTS + 2);
+		break;
+	case 3:
+		bw = w / BARS;
+		for (i = 0; i < BARS; i++) {
+			int bh = (h / 2) * (1 + ((i * 7 + n) % 10)) / 10;
+
+			x = x0 + i * bw;
+			lcd_raster_set_color(r, 0x00c06020);
+			ops->fill_round_rect(r, x + 4, y0 + h - bh, bw - 8, bh, 6);
+			lcd_raster_set_color(r, 0x00ffffff);
+			ops->round_rect(r, x + 4, y0 + h - bh, bw - 8, bh, 6);
+		}
+		break;
+	case 4:
+		lcd_raster_set_color(r, 0x00ffff00);
+		for (i = 0; i < CHART_POINTS; i += 8)
+			ops->fill_circle(r, pts[i].x, pts[i].y, 4);
+		break;
+	case 5:
+		/* 表盘: 圆框 + 实心指针, 一部分超出屏幕测试裁剪 */
+		lcd_raster_set_color(r, 0x00e0e0e0);
+		ops->circle(r, s->width - 120, 120, 150);
+		lcd_raster_set_color(r, 0x00101010);
+		ops->fill_circle(r, s->width - 120, 120, 140);
+		a = n * 0.05;
+		needle[0].x = s->width - 120 + (int)(130 * cos(a));
+		needle[0].y = 120 + (int)(130 * sin(a));
+		needle[1].x = s->width - 120 + (int)(8 * cos(a + 1.57));
+		needle[1].y = 120 + (int)(8 * sin(a + 1.57));
+		needle[2].x = s->width - 120 - (int)(20 * cos(a));
+		needle[2].y = 120 - (int)(20 * sin(a));
+		needle[3].x = s->width - 120 + (int)(8 * cos(a - 1.57));
+		needle[3].y = 120 + (int)(8 * sin(a - 1.57));
+		lcd_raster_set_color(r, 0x00ff2020);
+		ops->fill_polygon(r, needle, 4);
+		break;
+	}
+}
+
+/* 每一部分重绘loops次的耗时(ms/次) */
+static void run(struct lcd_surface *s, const struct draw_ops *ops, int loops, double *ms)
+{
+	struct lcd_raster r;
+	double t0;
+	int k, n;
+
+	lcd_raster_init(&r, s);
+	lcd_surface_fill(s, 0);
+	for (k = 0; k < SCENES; k++) {
+		t0 = now_ms();
+		for (n = 0; n < loops; n++)
+			draw_scene(&r, ops, k, n);
+		ms[k] = (now_ms() - t0) / loops;
+	}
+}
+
+/*
+ * 正确性检查, 只使用lcd_raster_*
+ */
+static unsigned int pix(const struct lcd_surface *s, int x, int y)
+{
+	const unsigned char *p = (const unsigned char *)lcd_surface_row(s, y) + x * s->pixel_width;
+
+	switch (s->pixel_width) {
+	case 1:
+		return *p;
+	case 2:
+		return *(const uint16_t *)p;
+	default:
+		return *(const uint32_t *)p;
+	}
+}
+
+/* a中(ax,ay)开始的w x h区域与b中(bx,by)开始的区域相同 */
+static int region_equal(const struct lcd_surface *a, int ax, int ay,
+			const struct lcd_surface *b, int bx, int by, int w, int h)
+{
+	int y;
+
+	for (y = 0; y < h; y++)
+		if (memcmp((const unsigned char *)lcd_surface_row(a, ay + y) + ax * a->pixel_width,
+			   (const unsigned char *)lcd_surface_row(b, by + y) + bx * b->pixel_width,
+			   (size_t)w * a->pixel_width))
+			return 0;
+	return 1;
+}
+
+static int rnd(int lo, int hi)
+{
+	return lo + rand() % (hi - lo + 1);
+}
+
+/* 按种子画一组随机图元, 坐标整体平移(ox,oy), 相当一部分超出CHECK_W x CHECK_H */
+static void draw_random(struct lcd_raster *r, unsigned int seed, int ox, int oy)
+{
+	struct lcd_point pts[7];
+	int i, j, n;
+
+	srand(seed);
+	for (i = 0; i < 40; i++) {
+		lcd_raster_set_color(r, rand() & 0xffffff);
+		switch (i % 6) {
+		case 0:
+			lcd_raster_line(r, ox + rnd(-60, CHECK_W + 60), oy + rnd(-60, CHECK_H + 60),
+					ox + rnd(-60, CHECK_W + 60), oy + rnd(-60, CHECK_H + 60));
+			break;
+		case 1:
+			n = rnd(3, 7);
+			for (j = 0; j < n; j++) {
+				pts[j].x = ox + rnd(-60, CHECK_W + 60);
+				pts[j].y = oy + rnd(-60, CHECK_H + 60);
+			}
+			lcd_raster_fill_polygon(r, pts, n);
+			break;
+		case 2:
+			lcd_raster_circle(r, ox + rnd(-40, CHECK_W + 40), oy + rnd(-40, CHECK_H + 40),
+					  rnd(0, 60));
+			break;
+		case 3:
+			lcd_raster_fill_circle(r, ox + rnd(-40, CHECK_W + 40),
+					       oy + rnd(-40, CHECK_H + 40), rnd(0, 60));
+			break;
+		case 4:
+			lcd_raster_round_rect(r, ox + rnd(-60, CHECK_W), oy + rnd(-60, CHECK_H),
+					      rnd(0, 120), rnd(0, 120), rnd(0, 30));
+			break;
+		case 5:
+			lcd_raster_fill_round_rect(r, ox + rnd(-60, CHECK_W), oy + rnd(-60, CHECK_H),
+						   rnd(0, 120), rnd(0, 120), rnd(0, 30));
+			break;
+		}
+	}
+}
+
+/* 轴对齐矩形的多边形与fill_rect覆盖相同的像素, 包括宽或高为0、超出画面和坐标很大的 */
+static int check_polygon_rect(struct lcd_surface *a, struct lcd_surface *b)
+{
+	struct lcd_raster ra, rb;
+	struct lcd_point pts[4];
+	int i, x, y, w, h;
+
+	lcd_raster_init(&ra, a);
+	lcd_raster_init(&rb, b);
+	lcd_surface_fill(a, 0);
+	lcd_surface_fill(b, 0);
+	srand(1);
+	for (i = 0; i < 300; i++) {
+		x = rnd(-40, CHECK_W);
+		y = rnd(-40, CHECK_H);
+		w = rnd(0, 80);
+		h = rnd(0, 80);
+		if (i % 10 == 0) {
+			/* 左上角远在画面外, 超出16.16定点数的范围 */
+			x = -rnd(40000, 1000000);
+			y = -rnd(40000, 1000000);
+			w = -x + rnd(0, CHECK_W);
+			h = -y + rnd(0, CHECK_H);
+		}
+		pts[0].x = x;
+		pts[0].y = y;
+		pts[1].x = x + w;
+		pts[1].y = y;
+		pts[2].x = x + w;
+		pts[2].y = y + h;
+		pts[3].x = x;
+		pts[3].y = y + h;
+		lcd_raster_set_color(&ra, i + 1);
+		lcd_raster_set_color(&rb, i + 1);
+		lcd_raster_fill_polygon(&ra, pts, 4);
+		lcd_raster_fill_rect(&rb, x, y, w, h);
+	}
+	return region_equal(a, 0, 0, b, 0, 0, CHECK_W, CHECK_H);
+}
+
+/* 超出画面的部分被裁掉, 可见部分与在更大的画面上不裁剪画出的相同 */
+static int check_edge_clip(struct lcd_surface *a, struct lcd_surface *big)
+{
+	struct lcd_raster ra, rb;
+	unsigned int seed;
+
+	lcd_raster_init(&ra, a);
+	lcd_raster_init(&rb, big);
+	for (seed = 1; seed <= 20; seed++) {
+		lcd_surface_fill(a, 0);
+		lcd_surface_fill(big, 0);
+		draw_random(&ra, seed, 0, 0);
+		draw_random(&rb, seed, CHECK_MARGIN, CHECK_MARGIN);
+		if (!region_equal(a, 0, 0, big, CHECK_MARGIN, CHECK_MARGIN, CHECK_W, CHECK_H))
+			return 0;
+	}
+	return 1;
+}
+
+/* 设置裁剪矩形后: 矩形内与不裁剪时相同, 矩形外不变; 空的裁剪矩形什么都不画 */
+static int check_clip_rect(struct lcd_surface *a, struct lcd_surface *b)
+{
+	static const int clips[][4] = {
+		{ 50, 40, 100, 80 }, { -20, -20, 60, 50 }, { 250, 180, 200, 200 },
+		{ 0, 0, CHECK_W, 1 }, { 100, 100, 1, 1 },
+		/* 空: 宽或高为0、为负、完全在画面外 */
+		{ 10, 10, 0, 50 }, { 10, 10, 50, -5 }, { CHECK_W, 0, 40, 40 }, { -100, -100, 50, 50 },
+	};
+	struct lcd_raster ra, rb;
+	unsigned int i;
+	int x, y, cx0, cy0, cx1, cy1;
+
+	lcd_raster_init(&ra, a);
+	lcd_raster_init(&rb, b);
+	for (i = 0; i < sizeof(clips) / sizeof(clips[0]); i++) {
+		lcd_surface_fill(a, 0);
+		lcd_surface_fill(b, 0);
+		lcd_raster_set_clip(&ra, clips[i][0], clips[i][1], clips[i][2], clips[i][3]);
+		draw_random(&ra, i + 100, 0, 0);
+		draw_random(&rb, i + 100, 0, 0);
+
+		cx0 = ra.clip_x0;
+		cy0 = ra.clip_y0;
+		cx1 = ra.clip_x1;
+		cy1 = ra.clip_y1;
+		for (y = 0; y < CHECK_H; y++)
+			for (x = 0; x < CHECK_W; x++) {
+				int inside = x >= cx0 && x < cx1 && y >= cy0 && y < cy1;
+
+				if (pix(a, x, y) != (inside ? pix(b, x, y) : 0))
+					return 0;
+			}
+	}
+	return 1;
+}
+
+/* (cx,cy)周围半径r+1内, 左右、上下对称; square非0时还要求关于对角线对称 */
+static int symmetric(const struct lcd_surface *s, int cx, int cy, int rw, int rh, int square)
+{
+	int dx, dy;
+
+	for (dy = -rh; dy <= rh; dy++)
+		for (dx = -rw; dx <= rw; dx++) {
+			unsigned int v = pix(s, cx + dx, cy + dy);
+
+			if (v != pix(s, cx - dx, cy + dy) || v != pix(s, cx + dx, cy - dy))
+				return 0;
+			if (square && v != pix(s, cx + dy, cy + dx))
+				return 0;
+		}
+	return 1;
+}
+
+/* 圆关于水平、竖直和对角线对称; 圆角矩形关于水平和竖直中线对称 */
+static int check_symmetry(struct lcd_surface *a)
+{
+	struct lcd_raster r;
+	int cx = CHECK_W / 2, cy = CHECK_H / 2, radius, w, h;
+
+	lcd_raster_init(&r, a);
+	lcd_raster_set_color(&r, 0xffffff);
+	for (radius = 0; radius <= 100; radius++) {
+		lcd_surface_fill(a, 0);
+		lcd_raster_circle(&r, cx, cy, radius);
+		if (!symmetric(a, cx, cy, radius + 1, radius + 1, 1))
+			return 0;
+		lcd_surface_fill(a, 0);
+		lcd_raster_fill_circle(&r, cx, cy, radius);
+		if (!symmetric(a, cx, cy, radius + 1, radius + 1, 1))
+			return 0;
+	}
+	/* 奇数宽高时中线落在像素中心上 */
+	for (w = 1; w <= 61; w += 6)
+		for (h = 1; h <= 41; h += 4)
+			for (radius = 0; radius <= 25; radius += 5) {
+				lcd_surface_fill(a, 0);
+				lcd_raster_round_rect(&r, cx - w / 2, cy - h / 2, w, h, radius);
+				if (!symmetric(a, cx, cy, w / 2 + 1, h / 2 + 1, 0))
+					return 0;
+				lcd_surface_fill(a, 0);
+				lcd_raster_fill_round_rect(&r, cx - w / 2, cy - h / 2, w, h, radius);
+				if (!symmetric(a, cx, cy, w / 2 + 1, h / 2 + 1, 0))
+					return 0;
+			}
+	return 1;
+}
+
+/* 直线包含两个端点, 主方向上每步恰好一个点, 反过来画结果相同 */
+static int check_line_endpoints(struct lcd_surface *a, struct lcd_surface *b)
+{
+	struct lcd_raster ra, rb;
+	int i, x, y, x0, y0, x1, y1, count, steps;
+
+	lcd_raster_init(&ra, a);
+	lcd_raster_init(&rb, b);
+	lcd_raster_set_color(&ra, 0xffffff);
+	lcd_raster_set_color(&rb, 0xffffff);
+	srand(2);
+	for (i = 0; i < 500; i++) {
+		x0 = rnd(0, CHECK_W - 1);
+		y0 = rnd(0, CHECK_H - 1);
+		switch (i % 5) {
+		case 0:		/* 水平 */
+			x1 = rnd(0, CHECK_W - 1);
+			y1 = y0;
+			break;
+		case 1:		/* 竖直 */
+			x1 = x0;
+			y1 = rnd(0, CHECK_H - 1);
+			break;
+		case 2:		/* 45度 */
+			steps = rnd(-50, 50);
+			x1 = x0 + steps;
+			y1 = y0 + (i & 8 ? steps : -steps);
+			if (x1 < 0 || x1 >= CHECK_W || y1 < 0 || y1 >= CHECK_H)
+				x1 = x0, y1 = y0;	/* 一个点 */
+			break;
+		default:
+			x1 = rnd(0, CHECK_W - 1);
+			y1 = rnd(0, CHECK_H - 1);
+			break;
+		}
+
+		lcd_surface_fill(a, 0);
+		lcd_surface_fill(b, 0);
+		lcd_raster_line(&ra, x0, y0, x1, y1);
+		lcd_raster_line(&rb, x1, y1, x0, y0);
+		if (!pix(a, x0, y0) || !pix(a, x1, y1))
+			return 0;
+		if (!region_equal(a, 0, 0, b, 0, 0, CHECK_W, CHECK_H))
+			return 0;
+
+		count = 0;
+		for (y = 0; y < CHECK_H; y++)
+			for (x = 0; x < CHECK_W; x++)
+				count += !!pix(a, x, y);
+		steps = abs(x1 - x0) > abs(y1 - y0) ? abs(x1 - x0) : abs(y1 - y0);
+		if (count != steps + 1)
+			return 0;
+	}
+	return 1;
+}
+
+/* 返回失败的项数 */
+static int check_geometry(unsigned int bpp)
+{
+	unsigned int pw = bpp / 8;
+	unsigned int big_w = CHECK_W + 2 * CHECK_MARGIN, big_h = CHECK_H + 2 * CHECK_MARGIN;
+	void *mem_a = malloc(CHECK_W * CHECK_H * pw), *mem_b = malloc(CHECK_W * CHECK_H * pw);
+	void *mem_big = malloc(big_w * big_h * pw);
+	struct lcd_surface a, b, big;
+	int fails = 0, ok;
+
+	if (!mem_a || !mem_b || !mem_big ||
+	    lcd_surface_init(&a, mem_a, CHECK_W, CHECK_H, 0, bpp) ||
+	    lcd_surface_init(&b, mem_b, CHECK_W, CHECK_H, 0, bpp) ||
+	    lcd_surface_init(&big, mem_big, big_w, big_h, 0, bpp)) {
+		printf("geometry checks: can't set up %ubpp surfaces\n", bpp);
+		free(mem_a);
+		free(mem_b);
+		free(mem_big);
+		return 1;
+	}
+
+	ok = check_polygon_rect(&a, &b);
+	printf("check %-28s %s\n", "polygon == fill_rect", ok ? "ok" : "FAIL");
+	fails += !ok;
+	ok = check_edge_clip(&a, &big);
+	printf("check %-28s %s\n", "clip at surface edges", ok ? "ok" : "FAIL");
+	fails += !ok;
+	ok = check_clip_rect(&a, &b);
+	printf("check %-28s %s\n", "clip rect / empty clip", ok ? "ok" : "FAIL");
+	fails += !ok;
+	ok = check_symmetry(&a);
+	printf("check %-28s %s\n", "circle/round rect symmetry", ok ? "ok" : "FAIL");
+	fails += !ok;
+	ok = check_line_endpoints(&a, &b);
+	printf("check %-28s %s\n", "line endpoints/steps", ok ? "ok" : "FAIL");
+	fails += !ok;
+
+	free(mem_a);
+	free(mem_b);
+	free(mem_big);
+	return fails;
+}
+
+int main(int argc, char **argv)
+{
+	int loops = (argc > 1) ? atoi(argv[1]) : 50;
+	unsigned int bpp = (argc > 2) ? strtoul(argv[2], NULL, 0) : 16;
+	const char *dev = (argc > 3) ? argv[3] : NULL;
+	double ms_span[SCENES], ms_plot[SCENES], sum_span = 0, sum_plot = 0;
+	struct lcd_display *disp;
+	struct lcd_surface *s;
+	int k, fails;
+
+	if (loops < 1)
+		loops = 1;
+	disp = dev ? lcd_display_open(dev, 1) : lcd_display_open_mem(1024, 600, bpp, 1);
+	if (!disp)
+		return -1;
+	s = lcd_display_buffer(disp, 0);
+
+	fails = check_geometry(disp->var.bits_per_pixel);
+
+	run(s, &span_ops, loops, ms_span);
+	run(s, &plot_ops, loops, ms_plot);
+
+	printf("%ux%u %ubpp, %d loops\n", s->width, s->height, disp->var.bits_per_pixel, loops);
+	printf("%-10s %12s %12s %8s\n", "scene", "span ms", "put_pixel ms", "speedup");
+	for (k = 0; k < SCENES; k++) {
+		printf("%-10s %12.3f %12.3f %7.1fx\n", scene_names[k], ms_span[k], ms_plot[k],
+		       ms_plot[k] / ms_span[k]);
+		sum_span += ms_span[k];
+		sum_plot += ms_plot[k];
+	}
+	printf("%-10s %12.3f %12.3f %7.1fx\n", "total", sum_span, sum_plot, sum_plot / sum_span);
+
+	lcd_display_close(disp);
+	return fails ? -1 : 0;
+}
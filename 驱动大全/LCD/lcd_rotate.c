@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "lcd_rotate.h"
+
+/*
+ * 90/270度旋转按"条带"进行: 每次生成目的画面中连续的若干行,
+ * 条带高度取一个cache line(64字节)能容纳的像素数, 这样每个源cache line只读一次;
+ * 条带先在cache中的临时buffer里用小块转置拼好, 再整行拷贝到目的buffer,
+ * 对写合并的显存形成连续的长突发写
+ */
+#define LCD_ROT_LINE_BYTES	64
+
+/* 小块大小: 16bpp用8x8, 32bpp用4x4, 正好各占一个128位寄存器 */
+#define LCD_BLK16	8
+#define LCD_BLK32	4
+
+static inline const unsigned char *src_pixel(const struct lcd_surface *s, int x, int y)
+{
+	return (const unsigned char *)lcd_surface_row(s, y) + x * s->pixel_width;
+}
+
+/*
+ * 小块转置: dst第i行第j列 = 源第j行第i个像素
+ * 源行之间相隔sstride字节, 目的行之间相隔dstride字节, 都可以为负数
+ */
+#ifdef __ARM_NEON
+static void transpose_blk16(unsigned char *dst, ptrdiff_t dstride,
+			    const unsigned char *src, ptrdiff_t sstride)
+{
+	uint16x8_t r0 = vld1q_u16((const uint16_t *)(src + 0 * sstride));
+	uint16x8_t r1 = vld1q_u16((const uint16_t *)(src + 1 * sstride));
+	uint16x8_t r2 = vld1q_u16((const uint16_t *)(src + 2 * sstride));
+	uint16x8_t r3 = vld1q_u16((const uint16_t *)(src + 3 * sstride));
+	uint16x8_t r4 = vld1q_u16((const uint16_t *)(src + 4 * sstride));
+	uint16x8_t r5 = vld1q_u16((const uint16_t *)(src + 5 * sstride));
+	uint16x8_t r6 = vld1q_u16((const uint16_t *)(src + 6 * sstride));
+	uint16x8_t r7 = vld1q_u16((const uint16_t *)(src + 7 * sstride));
+	uint16x8x2_t t01 = vtrnq_u16(r0, r1);
+	uint16x8x2_t t23 = vtrnq_u16(r2, r3);
+	uint16x8x2_t t45 = vtrnq_u16(r4, r5);
+	uint16x8x2_t t67 = vtrnq_u16(r6, r7);
+	uint32x4x2_t u02 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[0]), vreinterpretq_u32_u16(t23.val[0]));
+	uint32x4x2_t u13 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[1]), vreinterpretq_u32_u16(t23.val[1]));
+	uint32x4x2_t u46 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[0]), vreinterpretq_u32_u16(t67.val[0]));
+	uint32x4x2_t u57 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[1]), vreinterpretq_u32_u16(t67.val[1]));
+
+	/* 最后交换64位的一半, 得到8列 */
+	vst1q_u16((uint16_t *)(dst + 0 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u02.val[0]), vget_low_u32(u46.val[0]))));
+	vst1q_u16((uint16_t *)(dst + 1 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u13.val[0]), vget_low_u32(u57.val[0]))));
+	vst1q_u16((uint16_t *)(dst + 2 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u02.val[1]), vget_low_u32(u46.val[1]))));
+	vst1q_u16((uint16_t *)(dst + 3 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u13.val[1]), vget_low_u32(u57.val[1]))));
+	vst1q_u16((uint16_t *)(dst + 4 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u02.val[0]), vget_high_u32(u46.val[0]))));
+	vst1q_u16((uint16_t *)(dst + 5 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u13.val[0]), vget_high_u32(u57.val[0]))));
+	vst1q_u16((uint16_t *)(dst + 6 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u02.val[1]), vget_high_u32(u46.val[1]))));
+	vst1q_u16((uint16_t *)(dst + 7 * dstride), vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u13.val[1]), vget_high_u32(u57.val[1]))));
+}
+
+static void transpose_blk32(unsigned char *dst, ptrdiff_t dstride,
+			    const unsigned char *src, ptrdiff_t sstride)
+{
+	uint32x4_t r0 = vld1q_u32((const uint32_t *)(src + 0 * sstride));
+	uint32x4_t r1 = vld1q_u32((const uint32_t *)(src + 1 * sstride));
+	uint32x4_t r2 = vld1q_u32((const uint32_t *)(src + 2 * sstride));
+	uint32x4_t r3 = vld1q_u32((const uint32_t *)(src + 3 * sstride));
+	uint32x4x2_t t01 = vtrnq_u32(r0, r1);
+	uint32x4x2_t t23 = vtrnq_u32(r2, r3);
+
+	vst1q_u32((uint32_t *)(dst + 0 * dstride), vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+	vst1q_u32((uint32_t *)(dst + 1 * dstride), vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+	vst1q_u32((uint32_t *)(dst + 2 * dstride), vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+	vst1q_u32((uint32_t *)(dst + 3 * dstride), vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+}
+#else
+#define LCD_DEFINE_TRANSPOSE(bits, n)							\
+static void transpose_blk##bits(unsigned char *dst, ptrdiff_t dstride,			\
+				const unsigned char *src, ptrdiff_t sstride)		\
+{											\
+	uint##bits##_t blk[n][n];							\
+	int i, j;									\
+											\
+	for (j = 0; j < n; j++)								\
+		memcpy(blk[j], src + j * sstride, sizeof(blk[j]));			\
+	for (i = 0; i < n; i++) {							\
+		uint##bits##_t *d = (uint##bits##_t *)(dst + i * dstride);		\
+		for (j = 0; j < n; j++)							\
+			d[j] = blk[j][i];						\
+	}										\
+}
+
+LCD_DEFINE_TRANSPOSE(16, LCD_BLK16)
+LCD_DEFINE_TRANSPOSE(32, LCD_BLK32)
+#endif
+
+/* 目的(x,y)对应的源像素, 用于边角不足一个小块的部分 */
+static inline const unsigned char *rot_src_pixel(const struct lcd_surface *src, int x, int y,
+						 enum lcd_transform t)
+{
+	if (t == LCD_ROTATE_90)
+		return src_pixel(src, y, src->height - 1 - x);
+	return src_pixel(src, src->width - 1 - y, x);
+}
+
+/*
+ * 90/270度旋转
+ * 90度:  dst(x,y) = src(y, sh-1-x), 小块的源行从下往上取
+ * 270度: dst(x,y) = src(sw-1-y, x), 小块的源行从上往下取, 转置结果按行逆序写
+ */
+static int lcd_rotate_90_270(struct lcd_surface *dst, const struct lcd_surface *src,
+			     enum lcd_transform t)
+{
+	unsigned int pw = src->pixel_width;
+	int blk = (pw == 2) ? LCD_BLK16 : LCD_BLK32;
+	int strip = LCD_ROT_LINE_BYTES / pw;
+	int dw = dst->width, dh = dst->height;
+	size_t scratch_stride = (size_t)dw * pw;
+	unsigned char *scratch;
+	int dy0, dx0, by, i, j;
+
+	if ((int)src->height != dw || (int)src->width != dh)
+		return -1;
+	scratch = malloc(scratch_stride * strip);
+	if (!scratch)
+		return -1;
+
+	for (dy0 = 0; dy0 < dh; dy0 += strip) {
+		int rows = (dh - dy0 < strip) ? dh - dy0 : strip;
+
+		for (dx0 = 0; dx0 < dw; dx0 += blk) {
+			for (by = 0; by < rows; by += blk) {
+				int y0 = dy0 + by;
+				unsigned char *d = scratch + by * scratch_stride + dx0 * pw;
+
+				if (dx0 + blk > dw || by + blk > rows) {
+					/* 边角: 逐像素 */
+					for (i = 0; i < blk && by + i < rows; i++)
+						for (j = 0; j < blk && dx0 + j < dw; j++)
+							memcpy(d + i * scratch_stride + j * pw,
+							       rot_src_pixel(src, dx0 + j, y0 + i, t), pw);
+					continue;
+				}
+
+				if (t == LCD_ROTATE_90) {
+					const unsigned char *s = src_pixel(src, y0, src->height - 1 - dx0);
+
+					if (pw == 2)
+						transpose_blk16(d, scratch_stride, s, -(ptrdiff_t)src->stride);
+					else
+						transpose_blk32(d, scratch_stride, s, -(ptrdiff_t)src->stride);
+				} else {
+					const unsigned char *s = src_pixel(src, src->width - y0 - blk, dx0);
+					unsigned char *dl = d + (blk - 1) * scratch_stride;
+
+					if (pw == 2)
+						transpose_blk16(dl, -(ptrdiff_t)scratch_stride, s, src->stride);
+					else
+						transpose_blk32(dl, -(ptrdiff_t)scratch_stride, s, src->stride);
+				}
+			}
+		}
+
+		/* 整行写出 */
+		for (i = 0; i < rows; i++)
+			memcpy(lcd_surface_row(dst, dy0 + i), scratch + i * scratch_stride, scratch_stride);
+	}
+
+	free(scratch);
+	return 0;
+}
+
+/* 一行左右翻转 */
+static void mirror_row(unsigned char *dst, const unsigned char *src, int width, unsigned int pw)
+{
+	int x = 0;
+
+	if (pw == 2) {
+		const uint16_t *s = (const uint16_t *)src + width;
+		uint16_t *d = (uint16_t *)dst;
+#ifdef __ARM_NEON
+		for (; x + 8 <= width; x += 8) {
+			uint16x8_t v;
+
+			s -= 8;
+			v = vrev64q_u16(vld1q_u16(s));
+			vst1q_u16(d + x, vcombine_u16(vget_high_u16(v), vget_low_u16(v)));
+		}
+#endif
+		for (; x < width; x++)
+			d[x] = *--s;
+	} else {
+		const uint32_t *s = (const uint32_t *)src + width;
+		uint32_t *d = (uint32_t *)dst;
+#ifdef __ARM_NEON
+		for (; x + 4 <= width; x += 4) {
+			uint32x4_t v;
+
+			s -= 4;
+			v = vrev64q_u32(vld1q_u32(s));
+			vst1q_u32(d + x, vcombine_u32(vget_high_u32(v), vget_low_u32(v)));
+		}
+#endif
+		for (; x < width; x++)
+			d[x] = *--s;
+	}
+}
+
+/**********************************************************************
+ * 函数名称： lcd_surface_transform
+ * 功能描述： 把src旋转/镜像后写入dst，目的画面按行从上到下顺序写出
+ * 输入参数： 目的surface，源surface，变换类型
+ * 输出参数： 无
+ * 返 回 值： 0-成功，-1-格式或尺寸不匹配
+ * 注     意:  src和dst不能重叠; 只支持16bpp和32bpp
+ ***********************************************************************/
+int lcd_surface_transform(struct lcd_surface *dst, const struct lcd_surface *src,
+			  enum lcd_transform t)
+{
+	unsigned int row_bytes;
+	int y;
+
+	if (src->format != dst->format || (src->pixel_width != 2 && src->pixel_width != 4))
+		return -1;
+
+	switch (t) {
+	case LCD_ROTATE_90:
+	case LCD_ROTATE_270:
+		return lcd_rotate_90_270(dst, src, t);
+	case LCD_ROTATE_180:
+	case LCD_MIRROR_H:
+	case LCD_MIRROR_V:
+		if (src->width != dst->width || src->height != dst->height)
+			return -1;
+		row_bytes = src->width * src->pixel_width;
+		for (y = 0; y < (int)dst->height; y++) {
+			int sy = (t == LCD_MIRROR_H) ? y : (int)src->height - 1 - y;
+
+			if (t == LCD_MIRROR_V)
+				memcpy(lcd_surface_row(dst, y), lcd_surface_row(src, sy), row_bytes);
+			else
+				mirror_row(lcd_surface_row(dst, y), lcd_surface_row(src, sy),
+					   src->width, src->pixel_width);
+		}
+		return 0;
+	}
+	return -1;
+}
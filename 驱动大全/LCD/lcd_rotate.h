@@ -0,0 +1,24 @@
+#ifndef _LCD_ROTATE_H
+#define _LCD_ROTATE_H
+
+#include "lcd_fb.h"
+
+/*
+ * 软件旋转/镜像: 没有PXP等硬件时使用
+ * 按目的行顺序写出, 可以直接写入FBIOPAN_DISPLAY的后台buffer
+ * 支持16bpp和32bpp, ARM上使用NEON转置, 其他平台使用标量实现
+ */
+
+enum lcd_transform {
+	LCD_ROTATE_90 = 0,	/* 顺时针90度, 同FB_ROTATE_CW */
+	LCD_ROTATE_180,
+	LCD_ROTATE_270,		/* 顺时针270度, 同FB_ROTATE_CCW */
+	LCD_MIRROR_H,		/* 左右镜像 */
+	LCD_MIRROR_V,		/* 上下镜像 */
+};
+
+/* 把src变换后写入dst, 90/270度时dst的宽高必须是src的高宽; 返回0表示成功 */
+int lcd_surface_transform(struct lcd_surface *dst, const struct lcd_surface *src,
+			  enum lcd_transform t);
+
+#endif /* _LCD_ROTATE_H */
@@ -0,0 +1,222 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+
+#include "lcd_fb.h"
+#include "lcd_rotate.h"
+
+/**********************************************************************
+ * 文件说明： 软件旋转/镜像的正确性检查和性能对比
+ * 用     法:  ./lcd_rotate_bench [bpp] [次数] [/dev/fbN]
+ * 				默认在内存surface上测试1024x600，不需要屏幕;
+ * 				指定fb设备时90/270度的结果直接写入后台buffer并切换显示,
+ * 				然后设置var.rotate测试驱动每帧的旋转耗时(MYLCDIO_PRESENT在调用者中旋转)
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -mfpu=neon -o lcd_rotate_bench \
+ * 				lcd_rotate_bench.c lcd_rotate.c lcd_fb.c
+ ***********************************************************************/
+
+#define BENCH_WIDTH	1024
+#define BENCH_HEIGHT	600
+
+static const char *names[] = { "rotate90", "rotate180", "rotate270", "mirror_h", "mirror_v" };
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* 参考实现: 按源像素顺序逐个搬运，目的按列写 */
+static void naive_transform(struct lcd_surface *dst, const struct lcd_surface *src,
+			    enum lcd_transform t)
+{
+	unsigned int x, y, dx = 0, dy = 0;
+	unsigned int pw = src->pixel_width;
+
+	for (x = 0; x < src->width; x++) {
+		for (y = 0; y < src->height; y++) {
+			switch (t) {
+			case LCD_ROTATE_90:  dx = src->height - 1 - y; dy = x; break;
+			case LCD_ROTATE_180: dx = src->width - 1 - x; dy = src->height - 1 - y; break;
+			case LCD_ROTATE_270: dx = y; dy = src->width - 1 - x; break;
+			case LCD_MIRROR_H:   dx = src->width - 1 - x; dy = y; break;
+			case LCD_MIRROR_V:   dx = x; dy = src->height - 1 - y; break;
+			}
+			memcpy((unsigned char *)lcd_surface_row(dst, dy) + dx * pw,
+			       (unsigned char *)lcd_surface_row(src, y) + x * pw, pw);
+		}
+	}
+}
+
+static int surface_equal(const struct lcd_surface *a, const struct lcd_surface *b)
+{
+	unsigned int y;
+
+	for (y = 0; y < a->height; y++)
+		if (memcmp(lcd_surface_row(a, y), lcd_surface_row(b, y), a->width * a->pixel_width))
+			return 0;
+	return 1;
+}
+
+/**********************************************************************
+ * 函数名称： driver_rotate_bench
+ * 功能描述： 测试驱动旋转(var.rotate)每帧的耗时
+ * 			  旋转时MYLCDIO_PRESENT在ioctl中把画面旋转到扫描buffer再排队,
+ * 			  每帧等它显示后再提交下一帧, ioctl的耗时就是一帧的旋转耗时
+ * 输入参数： fb设备的display，次数
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 注     意:  结果应与 /sys/.../rotate_stats 中的平均值一致, 测试完恢复为不旋转
+ ***********************************************************************/
+static void driver_rotate_bench(struct lcd_display *fb, int loops)
+{
+	static const char *angles[] = { "0", "90", "180", "270" };
+	struct pollfd pfd;
+	unsigned int r, index;
+	double t0, t, sum, max;
+	int i;
+
+	if (fb->present_emulated) {
+		printf("driver has no MYLCDIO_PRESENT, skip\n");
+		return;
+	}
+	pfd.fd = lcd_display_event_fd(fb);
+	pfd.events = POLLIN;
+	if (pfd.fd < 0)
+		return;
+
+	for (r = 1; r <= 3; r++) {
+		if (lcd_display_set_rotate(fb, r) || fb->nbuffers < 2)
+			break;
+		for (index = 0; index < fb->nbuffers; index++)
+			lcd_surface_fill(lcd_display_buffer(fb, index), index * 0x00404040);
+
+		sum = max = 0;
+		for (i = 0; i < loops; i++) {
+			index = (fb->front + 1) % fb->nbuffers;
+			t0 = now_ms();
+			if (lcd_display_present(fb, index)) {
+				perror("present");
+				break;
+			}
+			t = now_ms() - t0;
+			sum += t;
+			if (t > max)
+				max = t;
+			/* 等这一帧开始显示, 下一帧一定有空闲的扫描buffer */
+			while (fb->status.displayed < fb->status.submitted) {
+				if (poll(&pfd, 1, 1000) <= 0)
+					break;
+				lcd_display_dispatch(fb);
+			}
+		}
+		if (i == loops)
+			printf("driver rotate %-3s: %.3f ms/frame avg, %.3f ms max\n",
+			       angles[r], sum / loops, max);
+	}
+	lcd_display_set_rotate(fb, 0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int bpp = (argc > 1) ? strtoul(argv[1], NULL, 0) : 16;
+	int loops = (argc > 2) ? atoi(argv[2]) : 20;
+	struct lcd_display *src_disp, *ref_disp, *out_disp, *fb_disp = NULL;
+	struct lcd_surface *src, *ref_land, *ref_port, *out_land, *out_port;
+	unsigned int x, y;
+	int t, i, ret = 0;
+
+	if (loops < 1)
+		loops = 1;
+	/* 源: 横屏和竖屏各一份; 参考/输出: 同样 */
+	src_disp = lcd_display_open_mem(BENCH_WIDTH, BENCH_HEIGHT, bpp, 1);
+	ref_disp = lcd_display_open_mem(BENCH_WIDTH, BENCH_HEIGHT, bpp, 2);
+	out_disp = lcd_display_open_mem(BENCH_WIDTH, BENCH_HEIGHT, bpp, 2);
+	if (!src_disp || !ref_disp || !out_disp)
+		return -1;
+	src = lcd_display_buffer(src_disp, 0);
+	ref_land = lcd_display_buffer(ref_disp, 0);
+	out_land = lcd_display_buffer(out_disp, 0);
+	/* 竖屏surface使用第二个buffer的内存 */
+	ref_port = lcd_display_buffer(ref_disp, 1);
+	out_port = lcd_display_buffer(out_disp, 1);
+	lcd_surface_init(ref_port, ref_port->base, BENCH_HEIGHT, BENCH_WIDTH, 0, bpp);
+	lcd_surface_init(out_port, out_port->base, BENCH_HEIGHT, BENCH_WIDTH, 0, bpp);
+
+	if (argc > 3) {
+		fb_disp = lcd_display_open(argv[3], 2);
+		if (!fb_disp)
+			return -1;
+	}
+
+	/* 填充可以区分每个像素的图案 */
+	srand(1);
+	for (y = 0; y < src->height; y++)
+		for (x = 0; x < src->width; x++)
+			lcd_surface_put_pixel(src, x, y, rand() & 0xffffff);
+
+	printf("%ux%u %ubpp, %d loops\n", BENCH_WIDTH, BENCH_HEIGHT, bpp, loops);
+	printf("%-10s %12s %12s %8s %s\n", "transform", "naive ms", "tiled ms", "speedup", "check");
+	for (t = LCD_ROTATE_90; t <= LCD_MIRROR_V; t++) {
+		int swap = (t == LCD_ROTATE_90 || t == LCD_ROTATE_270);
+		struct lcd_surface *ref = swap ? ref_port : ref_land;
+		struct lcd_surface *out = swap ? out_port : out_land;
+		double t0, t_naive, t_tiled;
+		int ok;
+
+		t0 = now_ms();
+		for (i = 0; i < loops; i++)
+			naive_transform(ref, src, t);
+		t_naive = (now_ms() - t0) / loops;
+
+		t0 = now_ms();
+		for (i = 0; i < loops; i++)
+			if (lcd_surface_transform(out, src, t))
+				return -1;
+		t_tiled = (now_ms() - t0) / loops;
+
+		ok = surface_equal(ref, out);
+		if (!ok)
+			ret = -1;
+		printf("%-10s %12.3f %12.3f %7.2fx %s\n", names[t], t_naive, t_tiled,
+		       t_naive / t_tiled, ok ? "ok" : "MISMATCH");
+	}
+
+	/* 直接写入显存的后台buffer: 竖屏画面旋转到横屏面板 */
+	if (fb_disp) {
+		struct lcd_surface port;
+		unsigned int back;
+		double t0;
+
+		if (fb_disp->var.xres != BENCH_WIDTH || fb_disp->var.yres != BENCH_HEIGHT ||
+		    fb_disp->var.bits_per_pixel != bpp) {
+			printf("fb is %ux%u %ubpp, skip\n", fb_disp->var.xres, fb_disp->var.yres,
+			       fb_disp->var.bits_per_pixel);
+		} else {
+			port = *out_port;
+			naive_transform(&port, src, LCD_ROTATE_90);
+			for (t = LCD_ROTATE_90; t <= LCD_ROTATE_270; t += 2) {
+				t0 = now_ms();
+				for (i = 0; i < loops; i++) {
+					back = lcd_display_back_index(fb_disp);
+					lcd_surface_transform(lcd_display_buffer(fb_disp, back), &port, t);
+					lcd_display_flip(fb_disp, back);
+				}
+				printf("%s to fb: %.3f ms/frame\n", names[t], (now_ms() - t0) / loops);
+			}
+			driver_rotate_bench(fb_disp, loops);
+		}
+		lcd_display_close(fb_disp);
+	}
+
+	lcd_display_close(src_disp);
+	lcd_display_close(ref_disp);
+	lcd_display_close(out_disp);
+	return ret;
+}
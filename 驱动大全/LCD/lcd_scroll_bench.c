@@ -0,0 +1,132 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcd_fb.h"
+
+/**********************************************************************
+ * 文件说明： 滚屏性能对比: 拷贝整屏 vs 修改yoffset平移(YPAN)
+ * 用     法:  ./lcd_scroll_bench [行数] [/dev/fbN]
+ * 				不指定设备时在1024x600 16bpp、3屏高的内存surface上测试
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -o lcd_scroll_bench \
+ * 				lcd_scroll_bench.c lcd_fb.c
+ ***********************************************************************/
+
+#define LINE_HEIGHT	16	/* 一行文字的高度(像素), 与8x16字体一致 */
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 在虚拟屏幕的第y行开始画一行"文字": 清背景, 再画若干短横线模拟字形 */
+static void draw_text_line(struct lcd_surface *virt, int y, unsigned int n)
+{
+	unsigned int bg = lcd_color_pack(virt->format, 0);
+	unsigned int fg = lcd_color_pack(virt->format, 0x00c0c0c0);
+	int i, x;
+
+	for (i = 0; i < LINE_HEIGHT; i++)
+		lcd_surface_fill_span(virt, 0, y + i, virt->width, bg);
+	for (x = (n % 7) * 8; x < (int)virt->width - 8; x += 16)
+		for (i = 3; i < LINE_HEIGHT - 3; i += 4)
+			lcd_surface_fill_span(virt, x, y + i, 6, fg);
+}
+
+/* 拷贝滚屏: 整屏上移一行, 在最底部画新行 */
+static double scroll_copy(struct lcd_display *disp, struct lcd_surface *virt, unsigned int lines)
+{
+	size_t move = (size_t)disp->fix.line_length * (disp->var.yres - LINE_HEIGHT);
+	unsigned char *top;
+	unsigned int n;
+	double t0;
+
+	lcd_display_pan(disp, 0);
+	top = lcd_surface_row(virt, 0);
+	t0 = now_s();
+	for (n = 0; n < lines; n++) {
+		memmove(top, top + (size_t)disp->fix.line_length * LINE_HEIGHT, move);
+		draw_text_line(virt, disp->var.yres - LINE_HEIGHT, n);
+	}
+	return lines / (now_s() - t0);
+}
+
+/*
+ * 平移滚屏(同fbcon的SCROLL_PAN_MOVE): 新行画在窗口下方再平移一行,
+ * 到达虚拟屏幕底部时才把当前窗口拷贝回顶部
+ * 本驱动没有快速读/拷贝, fbcon用的是SCROLL_PAN_REDRAW, 到底部时重画而不是拷贝,
+ * 平移部分与这里相同
+ */
+static double scroll_pan(struct lcd_display *disp, struct lcd_surface *virt, unsigned int lines,
+			 unsigned int *copies)
+{
+	unsigned int yres = disp->var.yres;
+	unsigned int yoffset = 0;
+	unsigned int n;
+	double t0;
+
+	*copies = 0;
+	lcd_display_pan(disp, 0);
+	t0 = now_s();
+	for (n = 0; n < lines; n++) {
+		if (yoffset + yres + LINE_HEIGHT > disp->var.yres_virtual) {
+			memmove(lcd_surface_row(virt, 0), lcd_surface_row(virt, yoffset),
+				(size_t)disp->fix.line_length * yres);
+			yoffset = 0;
+			(*copies)++;
+		}
+		draw_text_line(virt, yoffset + yres, n);
+		yoffset += LINE_HEIGHT;
+		if (lcd_display_pan(disp, yoffset))
+			return -1;
+	}
+	return lines / (now_s() - t0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int lines = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2000;
+	struct lcd_display *disp;
+	struct lcd_surface virt;
+	unsigned int copies;
+	double copy_rate, pan_rate;
+
+	if (argc > 2)
+		disp = lcd_display_open(argv[2], 0);
+	else
+		disp = lcd_display_open_mem(1024, 600, 16, 3);
+	if (!disp)
+		return -1;
+	if (!lines)
+		lines = 1;
+
+	/* 覆盖整个虚拟屏幕的surface */
+	if (lcd_surface_init(&virt, disp->map_base, disp->var.xres, disp->var.yres_virtual,
+			     disp->fix.line_length, disp->var.bits_per_pixel))
+		return -1;
+	printf("%ux%u virtual %u, %ubpp, %u lines of %u pixels\n", disp->var.xres, disp->var.yres,
+	       disp->var.yres_virtual, disp->var.bits_per_pixel, lines, LINE_HEIGHT);
+
+	copy_rate = scroll_copy(disp, &virt, lines);
+	printf("copy: %10.0f lines/s\n", copy_rate);
+	if (disp->var.yres_virtual < disp->var.yres + LINE_HEIGHT) {
+		printf("pan : virtual screen too small, driver has no room to pan\n");
+	} else {
+		pan_rate = scroll_pan(disp, &virt, lines, &copies);
+		if (pan_rate < 0) {
+			printf("pan : FBIOPAN_DISPLAY failed\n");
+		} else {
+			printf("pan : %10.0f lines/s (%u wrap copies)\n", pan_rate, copies);
+			printf("speedup %.1fx\n", pan_rate / copy_rate);
+		}
+	}
+
+	lcd_display_pan(disp, 0);
+	lcd_display_close(disp);
+	return 0;
+}
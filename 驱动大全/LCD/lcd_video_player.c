@@ -0,0 +1,555 @@
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "lcd_fb.h"
+
+/**********************************************************************
+ * 文件说明： 流式播放预先渲染的原始视频(逐帧存放的RGB数据)
+ * 			  读文件、格式转换、送显分别在三个线程中流水线执行,
+ * 			  线程之间用有界队列连接, 下游慢时上游自动阻塞(反压)
+ * 			  读线程: posix_fadvise顺序预读, 读过的部分DONTNEED, 不挤占page cache
+ * 			  转换线程: 把读到的帧转换为显示格式, 直接写入空闲的后台buffer
+ * 			  送显线程: MYLCDIO_PRESENT异步提交(不支持时退化为FBIOPAN_DISPLAY),
+ * 			  			按fence回收不再扫描的buffer
+ * 用     法:  ./lcd_video_player <file> <width> <height> <rgb565|rgb888|xrgb8888>
+ * 				[/dev/fbN|mem] [fps] [loops]
+ * 				mem: 在1024x600 16bpp的内存surface上播放, 用于测量流水线吞吐量
+ * 				fps: 0表示不限速(由显示刷新率或最慢的一级决定)
+ * 编     译:  arm-buildroot-linux-gnueabihf-gcc -O2 -o lcd_video_player \
+ * 				lcd_video_player.c lcd_fb.c -lpthread
+ ***********************************************************************/
+
+#define READ_SLOTS		4	/* 读线程和转换线程之间的帧缓冲个数 */
+#define READAHEAD_FRAMES	8	/* 预读的帧数 */
+
+enum src_format {
+	SRC_RGB565,
+	SRC_RGB888,	/* 每像素3字节, 依次为R G B */
+	SRC_XRGB8888,	/* 小端32位 0x00RRGGBB */
+};
+
+/* 有界队列: 存放buffer序号, 满时push阻塞, 空时pop阻塞 */
+struct queue {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	int items[LCD_MAX_BUFFERS > READ_SLOTS ? LCD_MAX_BUFFERS : READ_SLOTS];
+	unsigned int head, count, size;
+	int closed;
+};
+
+/* 每一级的时间统计(秒) */
+struct stage_stat {
+	const char *name;
+	unsigned int frames;
+	double busy;		/* 实际工作 */
+	double wait_in;		/* 等待上游 */
+	double wait_out;	/* 等待下游(反压), 送显时是等待驱动队列空出位置 */
+	double pace;		/* 按帧率限速的休眠, 属于空闲 */
+};
+
+struct player {
+	/* 输入 */
+	int fd;
+	enum src_format format;
+	unsigned int width, height, src_bpp;
+	size_t frame_size;
+	unsigned int loops;
+	unsigned char *slots[READ_SLOTS];
+
+	/* 输出 */
+	struct lcd_display *disp;
+	unsigned int fps;
+
+	struct queue empty;	/* 空闲的读缓冲 */
+	struct queue filled;	/* 已读入的帧 */
+	struct queue free_bufs;	/* 空闲的显示buffer */
+	struct queue ready;	/* 已转换, 等待送显的显示buffer */
+
+	struct stage_stat st_read, st_conv, st_present;
+	volatile int error;
+};
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void queue_init(struct queue *q, unsigned int size)
+{
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	q->head = q->count = 0;
+	q->size = size;
+	q->closed = 0;
+}
+
+/* 放入一项, 阻塞的时间累加到*wait */
+static void queue_push(struct queue *q, int item, double *wait)
+{
+	double t0 = now_s();
+
+	pthread_mutex_lock(&q->lock);
+	while (q->count == q->size && !q->closed)
+		pthread_cond_wait(&q->not_full, &q->lock);
+	if (!q->closed) {
+		q->items[(q->head + q->count) % q->size] = item;
+		q->count++;
+		pthread_cond_signal(&q->not_empty);
+	}
+	pthread_mutex_unlock(&q->lock);
+	if (wait)
+		*wait += now_s() - t0;
+}
+
+/* 取出一项; 队列关闭且为空时返回-1; block为0时不等待 */
+static int queue_pop(struct queue *q, int block, double *wait)
+{
+	double t0 = now_s();
+	int item = -1;
+
+	pthread_mutex_lock(&q->lock);
+	while (block && q->count == 0 && !q->closed)
+		pthread_cond_wait(&q->not_empty, &q->lock);
+	if (q->count) {
+		item = q->items[q->head];
+		q->head = (q->head + 1) % q->size;
+		q->count--;
+		pthread_cond_signal(&q->not_full);
+	}
+	pthread_mutex_unlock(&q->lock);
+	if (wait)
+		*wait += now_s() - t0;
+	return item;
+}
+
+/* 关闭队列: 唤醒所有等待者, 之后的push被丢弃 */
+static void queue_close(struct queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_cond_broadcast(&q->not_full);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* 出错时关闭所有队列, 让三个线程都退出 */
+static void player_abort(struct player *p)
+{
+	p->error = 1;
+	queue_close(&p->empty);
+	queue_close(&p->filled);
+	queue_close(&p->free_bufs);
+	queue_close(&p->ready);
+}
+
+/* 读满一帧, 返回0-成功, 1-文件结束, -1-出错 */
+static int read_frame(int fd, unsigned char *buf, size_t size)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < size) {
+		n = read(fd, buf + done, size - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -1;
+		if (n == 0)
+			return done ? -1 : 1;	/* 末尾不完整的帧视为错误 */
+		done += n;
+	}
+	return 0;
+}
+
+/*
+ * 读线程: 顺序读入每一帧
+ * 提前READAHEAD_FRAMES帧发出WILLNEED, 读完的帧DONTNEED,
+ * 播放大文件时page cache只保留预读窗口
+ */
+static void *reader_thread(void *arg)
+{
+	struct player *p = arg;
+	struct stage_stat *st = &p->st_read;
+	unsigned int loop;
+	off_t off;
+	double t0;
+	int slot, ret;
+
+	posix_fadvise(p->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	for (loop = 0; loop < p->loops && !p->error; loop++) {
+		off = 0;
+		if (lseek(p->fd, 0, SEEK_SET) < 0)
+			break;
+		while (!p->error) {
+			slot = queue_pop(&p->empty, 1, &st->wait_out);
+			if (slot < 0)
+				goto out;
+
+			t0 = now_s();
+			posix_fadvise(p->fd, off + p->frame_size,
+				      (off_t)p->frame_size * READAHEAD_FRAMES, POSIX_FADV_WILLNEED);
+			ret = read_frame(p->fd, p->slots[slot], p->frame_size);
+			if (ret == 0 && off)
+				posix_fadvise(p->fd, off - p->frame_size, p->frame_size,
+					      POSIX_FADV_DONTNEED);
+			st->busy += now_s() - t0;
+
+			if (ret) {
+				queue_push(&p->empty, slot, NULL);
+				if (ret < 0) {
+					printf("read error at offset %lld\n", (long long)off);
+					player_abort(p);
+				}
+				break;
+			}
+			off += p->frame_size;
+			st->frames++;
+			queue_push(&p->filled, slot, &st->wait_out);
+		}
+	}
+out:
+	queue_close(&p->filled);
+	return NULL;
+}
+
+static inline uint16_t rgb_to_565(unsigned int r, unsigned int g, unsigned int b)
+{
+	return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+/* 转换一行, n个像素 */
+static void convert_row(void *dst, enum lcd_format dfmt, const unsigned char *src,
+			enum src_format sfmt, unsigned int n)
+{
+	unsigned int i;
+
+	if (dfmt == LCD_FMT_RGB565) {
+		uint16_t *d = dst;
+
+		switch (sfmt) {
+		case SRC_RGB565:
+			memcpy(d, src, n * 2);
+			break;
+		case SRC_RGB888:
+			for (i = 0; i < n; i++, src += 3)
+				d[i] = rgb_to_565(src[0], src[1], src[2]);
+			break;
+		case SRC_XRGB8888:
+			for (i = 0; i < n; i++, src += 4)
+				d[i] = rgb_to_565(src[2], src[1], src[0]);
+			break;
+		}
+	} else {
+		uint32_t *d = dst;
+		const uint16_t *s16 = (const uint16_t *)src;
+
+		switch (sfmt) {
+		case SRC_RGB565:
+			for (i = 0; i < n; i++) {
+				unsigned int c = s16[i];
+				unsigned int r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+
+				d[i] = ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+			}
+			break;
+		case SRC_RGB888:
+			for (i = 0; i < n; i++, src += 3)
+				d[i] = (src[0] << 16) | (src[1] << 8) | src[2];
+			break;
+		case SRC_XRGB8888:
+			memcpy(d, src, n * 4);
+			break;
+		}
+	}
+}
+
+/*
+ * 转换线程: 取一帧输入和一个空闲的显示buffer, 转换后交给送显线程
+ * 画面居中, 超出屏幕的部分裁掉
+ */
+static void *converter_thread(void *arg)
+{
+	struct player *p = arg;
+	struct stage_stat *st = &p->st_conv;
+	struct lcd_surface *s0 = lcd_display_buffer(p->disp, 0);
+	unsigned int w = p->width < s0->width ? p->width : s0->width;
+	unsigned int h = p->height < s0->height ? p->height : s0->height;
+	unsigned int dx = (s0->width - w) / 2, dy = (s0->height - h) / 2;
+	unsigned int sx = (p->width - w) / 2, sy = (p->height - h) / 2;
+	size_t src_stride = (size_t)p->width * p->src_bpp;
+	unsigned int y;
+	double t0;
+	int slot, index;
+
+	while (1) {
+		slot = queue_pop(&p->filled, 1, &st->wait_in);
+		if (slot < 0)
+			break;
+		index = queue_pop(&p->free_bufs, 1, &st->wait_out);
+		if (index < 0)
+			break;
+
+		t0 = now_s();
+		{
+			struct lcd_surface *s = lcd_display_buffer(p->disp, index);
+			const unsigned char *src = p->slots[slot] + sy * src_stride + sx * p->src_bpp;
+
+			for (y = 0; y < h; y++)
+				convert_row((unsigned char *)lcd_surface_row(s, dy + y) + dx * s->pixel_width,
+					    s->format, src + y * src_stride, p->format, w);
+		}
+		st->busy += now_s() - t0;
+		st->frames++;
+
+		queue_push(&p->empty, slot, NULL);
+		queue_push(&p->ready, index, &st->wait_out);
+	}
+	queue_close(&p->ready);
+	return NULL;
+}
+
+/* 把已经不再扫描的buffer还给转换线程, 返回仍在显示或排队的buffer个数 */
+static unsigned int reclaim(struct player *p, int *inflight)
+{
+	struct lcd_display *disp = p->disp;
+	unsigned int i, n = 0;
+
+	for (i = 0; i < disp->nbuffers; i++) {
+		if (!inflight[i])
+			continue;
+		if (i != disp->front && disp->buf_seqno[i] <= disp->status.released) {
+			inflight[i] = 0;
+			queue_push(&p->free_bufs, i, NULL);
+		} else {
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * 送显线程: 按顺序异步提交, 帧率限制时按绝对时间对齐
+ * 没有新帧而驱动队列里还有帧时, 等待fence事件回收buffer
+ */
+static void *presenter_thread(void *arg)
+{
+	struct player *p = arg;
+	struct stage_stat *st = &p->st_present;
+	struct lcd_display *disp = p->disp;
+	int inflight[LCD_MAX_BUFFERS] = { 0 };
+	struct pollfd pfd;
+	struct timespec next;
+	long period_ns = p->fps ? 1000000000L / p->fps : 0;
+	double t0;
+	int index;
+
+	pfd.fd = lcd_display_event_fd(disp);
+	pfd.events = POLLIN;
+	inflight[disp->front] = 1;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (1) {
+		index = queue_pop(&p->ready, 0, NULL);
+		if (index < 0) {
+			/* 驱动中还有排队的帧: 等下一个fence事件, 期间转换线程继续工作 */
+			if (reclaim(p, inflight) > 1) {
+				t0 = now_s();
+				if (poll(&pfd, 1, 100) > 0)
+					lcd_display_dispatch(disp);
+				st->wait_in += now_s() - t0;
+				continue;
+			}
+			index = queue_pop(&p->ready, 1, &st->wait_in);
+			if (index < 0)
+				break;
+		}
+
+		if (period_ns) {
+			next.tv_nsec += period_ns;
+			while (next.tv_nsec >= 1000000000L) {
+				next.tv_nsec -= 1000000000L;
+				next.tv_sec++;
+			}
+			t0 = now_s();
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+			st->pace += now_s() - t0;
+		}
+
+		t0 = now_s();
+		while (lcd_display_present(disp, index)) {
+			/* 驱动队列满: 等待场同步, 即显示刷新率跟不上 */
+			if (errno != EBUSY) {
+				printf("present failed\n");
+				player_abort(p);
+				return NULL;
+			}
+			st->busy += now_s() - t0;
+			t0 = now_s();
+			if (poll(&pfd, 1, 100) > 0)
+				lcd_display_dispatch(disp);
+			st->wait_out += now_s() - t0;
+			t0 = now_s();
+		}
+		inflight[index] = 1;
+		st->busy += now_s() - t0;
+		st->frames++;
+
+		if (pfd.fd >= 0 && poll(&pfd, 1, 0) > 0)
+			lcd_display_dispatch(disp);
+		reclaim(p, inflight);
+	}
+	return NULL;
+}
+
+static void print_stage(const struct stage_stat *st, unsigned int frames)
+{
+	double n = frames ? frames : 1;
+
+	printf("%-8s %10.2f %12.2f %12.2f %10.2f\n", st->name, st->busy * 1000 / n,
+	       st->wait_in * 1000 / n, st->wait_out * 1000 / n, st->pace * 1000 / n);
+}
+
+static int parse_format(const char *name, enum src_format *format, unsigned int *bpp)
+{
+	if (!strcmp(name, "rgb565")) {
+		*format = SRC_RGB565;
+		*bpp = 2;
+	} else if (!strcmp(name, "rgb888")) {
+		*format = SRC_RGB888;
+		*bpp = 3;
+	} else if (!strcmp(name, "xrgb8888")) {
+		*format = SRC_XRGB8888;
+		*bpp = 4;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct player p;
+	pthread_t th_read, th_conv, th_present;
+	const char *dev = "/dev/fb0";
+	const struct stage_stat *slowest;
+	unsigned int i;
+	double t0, elapsed, slowest_s;
+
+	if (argc < 5) {
+		printf("usage : %s <file> <width> <height> <rgb565|rgb888|xrgb8888> "
+		       "[/dev/fbN|mem] [fps] [loops]\n", argv[0]);
+		return -1;
+	}
+	memset(&p, 0, sizeof(p));
+	p.width = strtoul(argv[2], NULL, 0);
+	p.height = strtoul(argv[3], NULL, 0);
+	if (!p.width || !p.height || parse_format(argv[4], &p.format, &p.src_bpp)) {
+		printf("bad frame size or format\n");
+		return -1;
+	}
+	if (argc > 5)
+		dev = argv[5];
+	p.fps = (argc > 6) ? strtoul(argv[6], NULL, 0) : 0;
+	p.loops = (argc > 7) ? strtoul(argv[7], NULL, 0) : 1;
+	if (!p.loops)
+		p.loops = 1;
+	p.frame_size = (size_t)p.width * p.height * p.src_bpp;
+
+	p.fd = open(argv[1], O_RDONLY);
+	if (p.fd < 0) {
+		printf("can't open %s\n", argv[1]);
+		return -1;
+	}
+	if (!strcmp(dev, "mem"))
+		p.disp = lcd_display_open_mem(1024, 600, 16, 3);
+	else
+		p.disp = lcd_display_open(dev, 0);
+	if (!p.disp)
+		return -1;
+	if (p.disp->nbuffers < 2 || p.disp->buffers[0].format == LCD_FMT_C8) {
+		printf("need at least 2 buffers in RGB565 or XRGB8888\n");
+		return -1;
+	}
+
+	queue_init(&p.empty, READ_SLOTS);
+	queue_init(&p.filled, READ_SLOTS);
+	queue_init(&p.free_bufs, p.disp->nbuffers);
+	queue_init(&p.ready, p.disp->nbuffers);
+	for (i = 0; i < READ_SLOTS; i++) {
+		p.slots[i] = malloc(p.frame_size);
+		if (!p.slots[i])
+			return -1;
+		queue_push(&p.empty, i, NULL);
+	}
+	/* 画面比屏幕小时四周保持黑色, 每个buffer只清一次 */
+	for (i = 0; i < p.disp->nbuffers; i++) {
+		lcd_surface_fill(lcd_display_buffer(p.disp, i), 0);
+		if (i != p.disp->front)
+			queue_push(&p.free_bufs, i, NULL);
+	}
+	p.st_read.name = "read";
+	p.st_conv.name = "convert";
+	p.st_present.name = "present";
+
+	printf("%s: %ux%u %s, %zu bytes/frame -> %ux%u %ubpp, %u buffers\n", argv[1],
+	       p.width, p.height, argv[4], p.frame_size, p.disp->var.xres, p.disp->var.yres,
+	       p.disp->var.bits_per_pixel, p.disp->nbuffers);
+
+	t0 = now_s();
+	pthread_create(&th_read, NULL, reader_thread, &p);
+	pthread_create(&th_conv, NULL, converter_thread, &p);
+	pthread_create(&th_present, NULL, presenter_thread, &p);
+	pthread_join(th_read, NULL);
+	pthread_join(th_conv, NULL);
+	pthread_join(th_present, NULL);
+	elapsed = now_s() - t0;
+
+	printf("%u frames in %.2f s, %.1f fps%s\n", p.st_present.frames, elapsed,
+	       p.st_present.frames / elapsed, p.error ? " (aborted)" : "");
+	printf("%-8s %10s %12s %12s %10s   (ms/frame)\n", "stage", "busy", "wait-in", "wait-out",
+	       "pace");
+	print_stage(&p.st_read, p.st_present.frames);
+	print_stage(&p.st_conv, p.st_present.frames);
+	print_stage(&p.st_present, p.st_present.frames);
+	/*
+	 * 忙的时间最长的一级决定帧率; 送显还要算上等待驱动队列(显示刷新率),
+	 * 按帧率限速的休眠是空闲, 不算
+	 */
+	slowest = &p.st_read;
+	slowest_s = p.st_read.busy;
+	if (p.st_conv.busy > slowest_s) {
+		slowest = &p.st_conv;
+		slowest_s = p.st_conv.busy;
+	}
+	if (p.st_present.busy + p.st_present.wait_out > slowest_s) {
+		slowest = &p.st_present;
+		slowest_s = p.st_present.busy + p.st_present.wait_out;
+	}
+	if (p.fps && p.st_present.frames &&
+	    slowest_s / p.st_present.frames < 0.9 / p.fps)
+		printf("bottleneck: none, limited to %u fps (slowest stage: %s)\n", p.fps,
+		       slowest->name);
+	else
+		printf("bottleneck: %s\n", slowest->name);
+
+	for (i = 0; i < READ_SLOTS; i++)
+		free(p.slots[i]);
+	lcd_display_close(p.disp);
+	close(p.fd);
+	return p.error ? -1 : 0;
+}